@@ -0,0 +1,420 @@
+#define HEADLESS
+#include "main.c"
+#include "bench.h"
+
+#define BENCH_DELTA (1.0f / 60)
+#define BENCH_TICKS 6000
+#define BENCH_STUCK_TICKS 20
+#define BENCH_MAX_VISITED 1024
+#define BENCH_NPC_TURN 60 //ticks between NPC direction changes
+#define BENCH_NPC_SPEED 2.0f
+#define BENCH_JOB_TICKS 1200 //npcs ticks per thread count in the scaling report
+#define BENCH_GRID_DENSITY 0.25f //NPCs per tile in the grid report, kept while the count grows
+#define BENCH_GRID_REPEATS 20
+
+typedef struct Scenario Scenario;
+
+struct Scenario {
+  const char *name;
+  int ticks;
+  void (*script)(int tick); //Fills input for the given tick.
+};
+
+void bench_steer(Vector2 target, float speed) {
+  Vector2 dir = Vector2Subtract(target, vector3_xz(test_object.pos));
+  input.move_translate = vector2_to_xz(Vector2Scale(Vector2Normalize(dir), speed), 0.0f);
+}
+
+//Serpentine over all 8x8 test chunks, hopping with the jetpack when blocked.
+Vector2 walk_last_pos;
+int walk_stuck;
+int walk_waypoint;
+
+Vector2 walk_get_waypoint(int i) {
+  if (i == 0)
+    return (Vector2){CHUNK_SIZE, 7.5f}; //out through the gap in the test map
+  int lane = (i - 1) / 2;
+  float end_x = lane % 2 == 0 ? 8 * CHUNK_SIZE - 1.5f : 1.5f;
+  return (Vector2){end_x, lane * (CHUNK_SIZE / 2) + CHUNK_SIZE / 4 + ((i - 1) % 2) * (CHUNK_SIZE / 2)};
+}
+
+void script_walk(int tick) {
+  const int c_waypoints = 1 + 8 * 2 * 2 - 1;
+  Vector2 pos = vector3_xz(test_object.pos);
+  if (tick == 0) {
+    walk_last_pos = pos;
+    walk_stuck = 0;
+    walk_waypoint = 0;
+  }
+  Vector2 target = walk_get_waypoint(walk_waypoint);
+  if (Vector2Distance(pos, target) < 1.0f && walk_waypoint < c_waypoints - 1)
+    target = walk_get_waypoint(++walk_waypoint);
+  bench_steer(target, INV_DIVINE * 10.0f);
+  if (Vector2DistanceSqr(pos, walk_last_pos) < 0.0001f)
+    walk_stuck++;
+  else
+    walk_stuck = 0;
+  walk_last_pos = pos;
+  input.jetpack = walk_stuck > BENCH_STUCK_TICKS || (walk_stuck > 0 && test_object.g_speed < 0.0f);
+}
+
+//Heads east out of the test map for as long as it runs, streaming chunks in and out.
+void script_far(int tick) {
+  Vector2 pos = vector3_xz(test_object.pos);
+  if (tick == 0) {
+    walk_last_pos = pos;
+    walk_stuck = 0;
+  }
+  Vector2 target = pos.x < CHUNK_SIZE ? walk_get_waypoint(0) : (Vector2){pos.x + CHUNK_SIZE, 7.5f};
+  bench_steer(target, INV_DIVINE * 10.0f * 10.0f);
+  if (Vector2DistanceSqr(pos, walk_last_pos) < 0.0001f)
+    walk_stuck++;
+  else
+    walk_stuck = 0;
+  walk_last_pos = pos;
+  input.jetpack = walk_stuck > BENCH_STUCK_TICKS || (walk_stuck > 0 && test_object.g_speed < 0.0f);
+}
+
+void script_jetpack(int tick) {
+  input.jetpack = (tick / 120) % 2 == 0;
+}
+
+void script_sprint(int tick) {
+  const Vector2 targets[] = {{7.5f, -4.0f}, {20.0f, 7.5f}, {7.5f, 20.0f}, {-4.0f, 7.5f}, {-4.0f, -4.0f}};
+  Vector2 target = targets[(tick / 90) % 5];
+  Vector2 dir = Vector2Normalize(Vector2Subtract(target, (Vector2){7.5f, 7.5f}));
+  input.move_translate = vector2_to_xz(Vector2Scale(dir, INV_DIVINE * 10.0f * 10.0f), 0.0f);
+}
+
+//Fills the active NPC set around the idle player and has every NPC wander, changing direction together.
+void script_npcs(int tick) {
+  NPCStore *npcs = &object_keeper.npcs;
+  if (tick == 0) {
+    for (int i = 0; i < MAX_ACTIVE_NPCS; i++) {
+      //the chunks streamed in around (0, 0) at setup
+      Vector2 p = {rng_float() * (CHUNK_LOAD_RADIUS * CHUNK_SIZE), rng_float() * (CHUNK_LOAD_RADIUS * CHUNK_SIZE)};
+      WorldChunk *chunk = find_chunk(p.x / CHUNK_SIZE, p.y / CHUNK_SIZE);
+      set_npc_active(create_npc(vector2_to_xz(p, get_chunk_height_at(chunk, p))), true);
+    }
+  }
+  if (tick % BENCH_NPC_TURN == 0) {
+    for (int i = 0; i < npcs->c_active; i++) {
+      float a = rng_float() * 2.0f * PI;
+      set_npc_velocity(npcs->handle[i], (Vector2){cosf(a) * BENCH_NPC_SPEED, sinf(a) * BENCH_NPC_SPEED});
+    }
+  }
+}
+
+//Scatters the whole inactive set over the streamed chunks and walks the serpentine through it,
+//so the activation manager wakes and puts NPCs to sleep while the rest tick dormant.
+void script_crowd(int tick) {
+  NPCStore *npcs = &object_keeper.npcs;
+  if (tick == 0) {
+    for (int i = 0; i < MAX_INACTIVE_NPCS; i++) {
+      Vector2 p = {rng_float() * (CHUNK_LOAD_RADIUS * CHUNK_SIZE), rng_float() * (CHUNK_LOAD_RADIUS * CHUNK_SIZE)};
+      WorldChunk *chunk = find_chunk(p.x / CHUNK_SIZE, p.y / CHUNK_SIZE);
+      create_npc(vector2_to_xz(p, get_chunk_height_at(chunk, p)));
+    }
+  }
+  if (tick % BENCH_NPC_TURN == 0) {
+    for (int i = 0; i < MAX_NPCS; i++) {
+      if (i == npcs->c_active)
+        i = MAX_ACTIVE_NPCS;
+      if (i == MAX_ACTIVE_NPCS + npcs->c_inactive)
+        break;
+      float a = rng_float() * 2.0f * PI;
+      set_npc_velocity(npcs->handle[i], (Vector2){cosf(a) * BENCH_NPC_SPEED, sinf(a) * BENCH_NPC_SPEED});
+    }
+  }
+  script_walk(tick);
+}
+
+void run_scenario(Scenario *s) {
+  long long *times = malloc(s->ticks * sizeof(long long));
+  int visited[BENCH_MAX_VISITED][2];
+  int c_visited = 0;
+  WorldChunk *last = NULL;
+  setup_world();
+  delta = BENCH_DELTA;
+  unsigned long allocs = 0;
+  long long total = 0;
+  for (int t = 0; t < s->ticks; t++) {
+    input = (Input){0};
+    input.move_speed = INV_DIVINE * 10.0f;
+    s->script(t);
+    unsigned long a = bench_allocs;
+    long long start = bench_now();
+    begin_frame();
+    update();
+    times[t] = bench_now() - start;
+    allocs += bench_allocs - a;
+    total += times[t];
+    WorldChunk *chunk = test_object.current_chunk;
+    if (chunk != last && c_visited < BENCH_MAX_VISITED) {
+      int v = 0;
+      while (v < c_visited && (visited[v][0] != chunk->w_pos[0] || visited[v][1] != chunk->w_pos[1]))
+        v++;
+      if (v == c_visited) {
+        visited[v][0] = chunk->w_pos[0];
+        visited[v][1] = chunk->w_pos[1];
+        c_visited++;
+      }
+      last = chunk;
+    }
+  }
+  qsort(times, s->ticks, sizeof(long long), bench_cmp);
+  printf("%-8s %6d %10.1f %12.2f %9lld %9lld %6d  (%.3f, %.3f, %.3f)\n",
+    s->name, s->ticks, (double)total / s->ticks, (double)allocs / s->ticks,
+    times[s->ticks / 2], times[s->ticks * 99 / 100], c_visited,
+    test_object.pos.x, test_object.pos.y, test_object.pos.z);
+  cleanup_world();
+  free(times);
+}
+
+void report_meshing(bool verbose) {
+  setup_world();
+  long before = 0;
+  long after = 0;
+  long before_bytes = 0;
+  long after_bytes = 0;
+  for (int i = 0; i < chunk_cache.c_chunks; i++) {
+    WorldChunk *chunk = chunk_cache.chunks + i;
+    int c_vertices;
+    generate_chunk_vertices(chunk, &c_vertices, &frame_arena.base);
+    arena_reset(&frame_arena);
+    MeshSource source = capture_mesh_source(chunk);
+    TerrainMesh mesh = build_chunk_mesh(&source);
+    int b = c_vertices / 3;
+    int b_bytes = b * (2 * 3 * sizeof(float) + 4);
+    int a_bytes = mesh.c_vertices * sizeof(TerrainVertex) + mesh.c_indices * sizeof(unsigned short);
+    if (verbose)
+      printf("chunk (%d, %d) %6d -> %6d vertices %8d -> %8d bytes\n", chunk->w_pos[0], chunk->w_pos[1], b, mesh.c_vertices, b_bytes, a_bytes);
+    before += b;
+    after += mesh.c_vertices;
+    before_bytes += b_bytes;
+    after_bytes += a_bytes;
+    release_terrain_mesh(&mesh);
+  }
+  printf("meshing  %ld -> %ld vertices (%.1fx), %ld -> %ld bytes\n", before, after, (double)before / after, before_bytes, after_bytes);
+  cleanup_world();
+}
+
+void report_mesh_pool() {
+  setup_world();
+  long long start = bench_now();
+  for (int i = 0; i < MIN(chunk_cache.c_chunks, MAX_MESH_JOBS); i++) {
+    MeshSource source = capture_mesh_source(chunk_cache.chunks + i);
+    TerrainMesh mesh = build_chunk_mesh(&source);
+    release_terrain_mesh(&mesh);
+  }
+  long long serial = bench_now() - start;
+  mesh_pool_start();
+  start = bench_now();
+  int c_requested = 0;
+  for (int i = 0; i < chunk_cache.c_chunks && c_requested < MAX_MESH_JOBS; i++)
+    c_requested += mesh_pool_request(chunk_cache.chunks + i);
+  MeshJob job;
+  for (int c = 0; c < c_requested;) {
+    if (mesh_pool_take(&job)) {
+      release_terrain_mesh(&job.mesh);
+      c++;
+    }
+  }
+  long long pooled = bench_now() - start;
+  mesh_pool_stop();
+  printf("mesh pool %d chunks: serial %.2f ms, %d workers %.2f ms\n", c_requested, serial / 1e6, MESH_WORKERS, pooled / 1e6);
+  cleanup_world();
+}
+
+//Hashes the active NPCs' movement columns, equal hashes mean bit-identical simulations.
+unsigned int hash_npcs() {
+  NPCStore *npcs = &object_keeper.npcs;
+  const float *columns[] = {npcs->pos_x, npcs->pos_y, npcs->pos_z, npcs->g_speed, npcs->frame_index};
+  unsigned int h = 2166136261u;
+  for (int c = 0; c < sizeof(columns) / sizeof(float *); c++) {
+    const unsigned char *bytes = (const unsigned char *)columns[c];
+    for (int i = 0; i < npcs->c_active * sizeof(float); i++)
+      h = (h ^ bytes[i]) * 16777619u;
+  }
+  return h;
+}
+
+//Runs the npcs scenario on 1 to N threads, N being the online cores (at least 2 so splitting is always checked).
+void report_npc_jobs() {
+  int max_threads = MIN(MAX(job_cpu_count(), 2), JOB_WORKERS + 1);
+  double base = 0.0;
+  for (int c_threads = 1; c_threads <= max_threads; c_threads++) {
+    job_system_start(c_threads - 1);
+    setup_world();
+    delta = BENCH_DELTA;
+    long long total = 0;
+    for (int t = 0; t < BENCH_JOB_TICKS; t++) {
+      input = (Input){0};
+      script_npcs(t);
+      long long start = bench_now();
+      begin_frame();
+      update_npcs();
+      total += bench_now() - start;
+    }
+    double ms = total / 1e6 / BENCH_JOB_TICKS;
+    if (c_threads == 1)
+      base = ms;
+    printf("npc jobs %d threads: %.3f ms/tick, %.2fx, hash %08x\n", c_threads, ms, base / ms, hash_npcs());
+    cleanup_world();
+    job_system_stop();
+  }
+}
+
+//Times the grid queries per NPC at growing NPC counts with a constant density, linear scaling keeps
+//the per NPC cost flat, and checks the pair query against a brute force count.
+void report_npc_grid() {
+  static NPCPair pairs[MAX_NPCS * 8];
+  for (int c_npcs = 256; c_npcs <= MAX_INACTIVE_NPCS; c_npcs *= 2) {
+    setup_world();
+    NPCStore *npcs = &object_keeper.npcs;
+    float side = sqrtf(c_npcs / BENCH_GRID_DENSITY);
+    for (int i = 0; i < c_npcs; i++)
+      create_npc((Vector3){rng_float() * side, 0.0f, rng_float() * side});
+    float r = 2.0f * test_object.radius;
+    long long start = bench_now();
+    int c_pairs = 0;
+    for (int t = 0; t < BENCH_GRID_REPEATS; t++)
+      c_pairs = find_npc_pairs(r, pairs, sizeof(pairs) / sizeof(NPCPair));
+    long long pair_time = bench_now() - start;
+    int c_brute = 0;
+    for (int i = MAX_ACTIVE_NPCS; i < MAX_ACTIVE_NPCS + npcs->c_inactive; i++) {
+      for (int j = i + 1; j < MAX_ACTIVE_NPCS + npcs->c_inactive; j++) {
+        float dx = npcs->pos_x[j] - npcs->pos_x[i];
+        float dz = npcs->pos_z[j] - npcs->pos_z[i];
+        c_brute += dx * dx + dz * dz < r * r;
+      }
+    }
+    NPCHandle found[NPC_MAX_NEAREST];
+    int c_found = 0;
+    start = bench_now();
+    for (int t = 0; t < BENCH_GRID_REPEATS; t++)
+      for (int i = MAX_ACTIVE_NPCS; i < MAX_ACTIVE_NPCS + npcs->c_inactive; i++)
+        c_found += find_nearest_npcs((Vector2){npcs->pos_x[i], npcs->pos_z[i]}, 8, 8.0f, found);
+    long long nearest_time = bench_now() - start;
+    start = bench_now();
+    for (int t = 0; t < BENCH_GRID_REPEATS; t++)
+      for (int i = MAX_ACTIVE_NPCS; i < MAX_ACTIVE_NPCS + npcs->c_inactive; i++)
+        c_found += find_npcs_in_circle((Vector2){npcs->pos_x[i], npcs->pos_z[i]}, 2.0f, found, NPC_MAX_NEAREST);
+    long long circle_time = bench_now() - start;
+    double per_npc = (double)BENCH_GRID_REPEATS * c_npcs;
+    printf("npc grid %4d npcs: pairs %.1f ns/npc (%d, brute force %d), nearest 8 %.1f ns, circle %.1f ns (%d found)\n",
+      c_npcs, pair_time / per_npc, c_pairs, c_brute, nearest_time / per_npc, circle_time / per_npc, c_found);
+    cleanup_world();
+  }
+}
+
+//Hashes the height maps of the chunks streamed in for a recording's seed and of one far outside
+//the map pack, which is always generated.
+unsigned int hash_recorded_world(const char *path, unsigned int seed) {
+  Replay recording;
+  if (!replay_record(&recording, path, seed))
+    return 0;
+  replay_close(&recording);
+  replay_load(&recording, path);
+  world_seed = recording.rng_seed;
+  replay_close(&recording);
+  setup_world();
+  load_chunk(1 << 16, 0);
+  unsigned int h = 2166136261u;
+  for (int i = 0; i < chunk_cache.c_chunks; i++) {
+    const unsigned char *bytes = (const unsigned char *)chunk_cache.chunks[i].height_map;
+    for (int b = 0; b < CHUNK_SIZE_S * sizeof(float); b++)
+      h = (h ^ bytes[b]) * 16777619u;
+  }
+  cleanup_world();
+  world_seed = RNG_SEED;
+  return h;
+}
+
+//Checks a recording's seed decides the world: the same seed twice matches, another seed differs.
+void report_world_seed() {
+  const char *path = "bench_seed.rep";
+  unsigned int a = hash_recorded_world(path, RNG_SEED);
+  unsigned int b = hash_recorded_world(path, RNG_SEED);
+  unsigned int c = hash_recorded_world(path, RNG_SEED + 1);
+  remove(path);
+  printf("world seed: same seed %s, other seed %s\n", a == b ? "matches" : "DIFFERS", a != c ? "differs" : "MATCHES");
+}
+
+//Checks tile lookups west and north of the origin land on the tile the position is in, every
+//height is compared with the chunk's own height map.
+void report_negative_tiles() {
+  setup_world();
+  WorldChunk *origin = load_chunk(0, 0);
+  int c_tiles = 0, c_wrong = 0;
+  for (int c = 0; c < 3; c++) {
+    int c_x = c == 1 ? 0 : -1, c_z = c == 0 ? 0 : -1;
+    WorldChunk *chunk = load_chunk(c_x, c_z);
+    for (int z = 0; z < CHUNK_SIZE; z++)
+      for (int x = 0; x < CHUNK_SIZE; x++) {
+        int w_x = c_x * CHUNK_SIZE + x, w_z = c_z * CHUNK_SIZE + z;
+        float h = chunk->height_map[z * CHUNK_SIZE + x];
+        c_tiles++;
+        if (get_tile_height(origin, w_x, w_z) != h
+          || get_chunk_height_at(chunk, (Vector2){w_x + 0.01f, w_z + 0.99f}) != h)
+          c_wrong++;
+      }
+  }
+  printf("negative tiles: %d checked, %d %s\n", c_tiles, c_wrong, c_wrong == 0 ? "wrong" : "WRONG");
+  cleanup_world();
+}
+
+//Plays a recording from the game's -record through update() with its own deltas and seed.
+int run_replay(const char *path) {
+  if (!replay_load(&replay, path)) {
+    fprintf(stderr, "could not load replay %s\n", path);
+    return 1;
+  }
+  world_seed = replay.rng_seed;
+  setup_world();
+  long long *times = calloc(replay.c_frames > 0 ? replay.c_frames : 1, sizeof(long long));
+  long long total = 0;
+  const ReplayFrame *frame;
+  while ((frame = replay_next(&replay)) != NULL) {
+    long long start = bench_now();
+    begin_frame();
+    replay_apply(frame);
+    update();
+    times[replay.cursor - 1] = bench_now() - start;
+    total += times[replay.cursor - 1];
+    replay_check(frame);
+  }
+  int c_frames = replay.c_frames > 0 ? replay.c_frames : 1;
+  qsort(times, replay.c_frames, sizeof(long long), bench_cmp);
+  printf("replay %d frames %.1f ns/tick, p50 %lld ns, p99 %lld ns, %d diverged (first %d)  (%.3f, %.3f, %.3f)\n",
+    replay.c_frames, (double)total / c_frames, times[replay.c_frames / 2], times[replay.c_frames * 99 / 100],
+    replay_divergences, replay_first_divergence, test_object.pos.x, test_object.pos.y, test_object.pos.z);
+  cleanup_world();
+  replay_close(&replay);
+  free(times);
+  return replay_divergences > 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2 && strcmp(argv[1], "-replay") == 0)
+    return run_replay(argv[2]);
+  bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+  Scenario scenarios[] = {
+    {"walk", BENCH_TICKS * 8, script_walk},
+    {"jetpack", BENCH_TICKS, script_jetpack},
+    {"sprint", BENCH_TICKS, script_sprint},
+    {"far", BENCH_TICKS, script_far},
+    {"npcs", BENCH_TICKS, script_npcs},
+    {"crowd", BENCH_TICKS, script_crowd}
+  };
+  printf("%-8s %6s %10s %12s %9s %9s %6s  %s\n", "scenario", "ticks", "ns/tick", "allocs/tick", "p50 ns", "p99 ns", "chunks", "final pos");
+  for (int i = 0; i < sizeof(scenarios) / sizeof(Scenario); i++)
+    run_scenario(scenarios + i);
+  report_meshing(verbose);
+  report_mesh_pool();
+  report_npc_jobs();
+  report_npc_grid();
+  report_world_seed();
+  report_negative_tiles();
+  return 0;
+}
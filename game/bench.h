@@ -0,0 +1,45 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <time.h>
+
+//Link with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc to count allocations.
+unsigned long bench_allocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void *__wrap_malloc(size_t size); //Counts and forwards to malloc.
+void *__wrap_calloc(size_t n, size_t size); //Counts and forwards to calloc.
+void *__wrap_realloc(void *p, size_t size); //Counts and forwards to realloc.
+long long bench_now(); //Returns a monotonic time in nanoseconds.
+int bench_cmp(const void *a, const void *b); //qsort comparison for long long.
+
+void *__wrap_malloc(size_t size) {
+  bench_allocs++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  bench_allocs++;
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+  bench_allocs++;
+  return __real_realloc(p, size);
+}
+
+long long bench_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int bench_cmp(const void *a, const void *b) {
+  long long x = *(const long long *)a;
+  long long y = *(const long long *)b;
+  return (x > y) - (x < y);
+}
+
+#endif
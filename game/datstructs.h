@@ -3,92 +3,393 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 
+#define ALLOC_ALIGN 16
+
+typedef struct Allocator Allocator;
+typedef struct Arena Arena;
+typedef struct Pool Pool;
 typedef struct UQueue UQueue;
-typedef struct _BBranch _BBranch;
-typedef struct BTree BTree;
+typedef struct PQueue PQueue;
+
+struct Allocator {
+  void *(*alloc)(Allocator *a, size_t size);
+  void *(*resize)(Allocator *a, void *p, size_t old_size, size_t size);
+  void (*release)(Allocator *a, void *p);
+  unsigned long bytes; //requested since the last allocator_reset_stats
+  unsigned long calls;
+};
+
+struct Arena {
+  Allocator base;
+  unsigned char *data;
+  size_t cap;
+  size_t used;
+  size_t last; //offset of the newest allocation, the only one that can grow in place
+  size_t peak; //highest used seen, for sizing cap
+};
+
+struct Pool {
+  Allocator base;
+  unsigned char *data;
+  size_t block;
+  unsigned int c_blocks;
+  unsigned int c_used;
+  void *free_list; //each free block holds a pointer to the next
+};
+
+typedef enum {
+  UQUEUE_UNIQUE = 0, //pushing a held value is a no-op, checked by scanning
+  UQUEUE_HASHED, //same as UQUEUE_UNIQUE through an open-addressing index
+  UQUEUE_FIFO //no uniqueness, pops free their slot right away
+} UQueueMode;
 
 struct UQueue {
   unsigned int max;
-  unsigned int first;
-  unsigned int len;
+  unsigned int first; //values popped since the last shift
+  unsigned int len; //values held, popped ones included until shifted out
   unsigned int size;
+  unsigned int head; //ring slot of the oldest held value
+  UQueueMode mode;
+  unsigned int c_index; //power of two, 0 without a hash index
+  unsigned int *index; //ring slot + 1 of each held value, 0 when empty
   unsigned char *data;
+  Allocator *alloc;
 };
 
-struct _BBranch {
-  _BBranch *left;
-  _BBranch *right;
-  float key;
-  void *value;
-};
-struct BTree {
-  _BBranch *root;
+//Binary min-heap of (key, value). There is no decrease-key: to relax a value (pathfinding), push it
+//again with the lower key and skip popped entries whose key is worse than the best one already
+//recorded for that value, keeping every step O(log n).
+struct PQueue {
+  unsigned int max;
+  unsigned int len;
   unsigned int size;
+  float *keys; //kept apart from data so sifting only touches floats until a swap
+  unsigned char *data;
+  Allocator *alloc;
 };
 
+void *_heap_alloc(Allocator *a, size_t size);
+void *_heap_resize(Allocator *a, void *p, size_t old_size, size_t size);
+void _heap_release(Allocator *a, void *p);
+void *_arena_alloc(Allocator *a, size_t size);
+void *_arena_resize(Allocator *a, void *p, size_t old_size, size_t size);
+void _arena_release(Allocator *a, void *p);
+void *_pool_alloc(Allocator *a, size_t size);
+void *_pool_resize(Allocator *a, void *p, size_t old_size, size_t size);
+void _pool_release(Allocator *a, void *p);
+void *mem_alloc(Allocator *a, size_t size); //Allocate through an allocator, NULL meaning the heap.
+void *mem_resize(Allocator *a, void *p, size_t old_size, size_t size); //Grow or shrink an allocation, keeping its contents.
+void mem_release(Allocator *a, void *p); //Give an allocation back (a no-op for most arena allocations).
+void allocator_reset_stats(Allocator *a); //Zero an allocator's byte and call counters.
+Arena arena_create(size_t cap); //Create a linear allocator over one fixed block, NULL is returned once it is full.
+void arena_destroy(Arena *arena); //Free arena memory.
+void arena_reset(Arena *arena); //Release every arena allocation at once.
+Pool pool_create(size_t block, unsigned int c_blocks); //Create a fixed-size block allocator.
+void pool_destroy(Pool *pool); //Free pool memory.
+
+unsigned int _memory_hash(const void *v, size_t size);
+unsigned int _pointer_hash(const void *p);
+unsigned int _uqueue_hash(UQueue *q, void *v);
+int _uqueue_find(UQueue *q, void *v);
+void _uqueue_unindex(UQueue *q, unsigned int slot);
 UQueue uqueue_create(unsigned int max, unsigned int size); //Create a queue.
+UQueue uqueue_create_mode(unsigned int max, unsigned int size, UQueueMode mode); //Create a queue with the given uniqueness mode.
+UQueue uqueue_create_in(Allocator *a, unsigned int max, unsigned int size, UQueueMode mode); //Create a queue whose memory comes from an allocator.
 void uqueue_destroy(UQueue *q); //Free queue memory.
+bool uqueue_contains(UQueue *q, void *v); //Check if the queue holds a value (popped ones count until shifted out).
 bool uqueue_push(UQueue *q, void *v); //Push a value into the queue.
 bool uqueue_pop(UQueue *q, void *v); //Obtain the next value from the queue.
 void uqueue_reset(UQueue *q); //Clear the queue.
-void uqueue_shift(UQueue *q); //Shift the queue's memory to the start.
+void uqueue_shift(UQueue *q); //Drop popped values to make room.
 void uqueue_restore(UQueue *q); //Set the iterator to 0 to "undo" pops.
 UQueue uqueue_copy(UQueue *q); //Deep copy of a queue.
 
-_BBranch *_bbranch_destroy(_BBranch *b);
-_BBranch *_bbranch_push(_BBranch *b, float k, void *v, unsigned int size);
-_BBranch *_bbranch_pop_low(_BBranch *b, void *v, unsigned int size);
-_BBranch *_bbranch_pop_high(_BBranch *b, void *v, unsigned int size);
-bool _bbranch_contains(_BBranch *b, float k, void *v, unsigned int size);
-BTree btree_create(unsigned int size); //Create a binary tree.
-void btree_destroy(BTree *t); //Free tree memory.
-void btree_push(BTree *t, float k, void *v); //Push a (key, value) into the tree.
-bool btree_pop_low(BTree *t, void *v); //Remove the lowest value and return it.
-bool btree_pop_high(BTree *t, void *v); //Remove the highest value and return it.
-bool btree_contains(BTree *t, float k, void *v); //Check if tree contains (key, value).
+void _pqueue_swap(PQueue *q, unsigned int i, unsigned int j);
+unsigned int _pqueue_sift_up(PQueue *q, unsigned int i);
+void _pqueue_sift_down(PQueue *q, unsigned int i);
+PQueue pqueue_create(unsigned int max, unsigned int size); //Create a min-priority queue, growing past max as needed.
+PQueue pqueue_create_in(Allocator *a, unsigned int max, unsigned int size); //Create a priority queue whose memory comes from an allocator.
+void pqueue_destroy(PQueue *q); //Free queue memory.
+bool pqueue_push(PQueue *q, float k, void *v); //Push a (key, value) into the queue, false when it can't grow (the queue is left as it was).
+bool pqueue_pop_low(PQueue *q, void *v); //Remove the value with the lowest key and return it.
+bool pqueue_pop_high(PQueue *q, void *v); //Remove the value with the highest key and return it.
+bool pqueue_contains(PQueue *q, float k, void *v); //Check if queue contains (key, value).
+void pqueue_reset(PQueue *q); //Clear the queue.
+
+Allocator heap_allocator = {_heap_alloc, _heap_resize, _heap_release, 0, 0}; //counters are only kept right on the main thread
+
+void *_heap_alloc(Allocator *a, size_t size) {
+  return malloc(size);
+}
+
+void *_heap_resize(Allocator *a, void *p, size_t old_size, size_t size) {
+  return realloc(p, size);
+}
+
+void _heap_release(Allocator *a, void *p) {
+  free(p);
+}
+
+void *_arena_alloc(Allocator *a, size_t size) {
+  Arena *arena = (Arena *)a;
+  size_t start = (arena->used + ALLOC_ALIGN - 1) & ~(size_t)(ALLOC_ALIGN - 1);
+  if (start + size > arena->cap)
+    return NULL;
+  arena->last = start;
+  arena->used = start + size;
+  if (arena->used > arena->peak)
+    arena->peak = arena->used;
+  return arena->data + start;
+}
+
+void *_arena_resize(Allocator *a, void *p, size_t old_size, size_t size) {
+  Arena *arena = (Arena *)a;
+  if (p == arena->data + arena->last && arena->last + size <= arena->cap) {
+    arena->used = arena->last + size;
+    if (arena->used > arena->peak)
+      arena->peak = arena->used;
+    return p;
+  }
+  void *new_p = _arena_alloc(a, size);
+  if (new_p != NULL && p != NULL)
+    memcpy(new_p, p, old_size < size ? old_size : size);
+  return new_p;
+}
+
+void _arena_release(Allocator *a, void *p) {
+  Arena *arena = (Arena *)a;
+  if (p == arena->data + arena->last)
+    arena->used = arena->last;
+}
+
+void *_pool_alloc(Allocator *a, size_t size) {
+  Pool *pool = (Pool *)a;
+  if (size > pool->block || pool->free_list == NULL)
+    return NULL;
+  void *p = pool->free_list;
+  pool->free_list = *(void **)p;
+  pool->c_used++;
+  return p;
+}
+
+void *_pool_resize(Allocator *a, void *p, size_t old_size, size_t size) {
+  Pool *pool = (Pool *)a;
+  if (p == NULL)
+    return _pool_alloc(a, size);
+  return size <= pool->block ? p : NULL;
+}
+
+void _pool_release(Allocator *a, void *p) {
+  Pool *pool = (Pool *)a;
+  if (p == NULL)
+    return;
+  *(void **)p = pool->free_list;
+  pool->free_list = p;
+  pool->c_used--;
+}
+
+void *mem_alloc(Allocator *a, size_t size) {
+  if (!a)
+    a = &heap_allocator;
+  a->bytes += size;
+  a->calls++;
+  return a->alloc(a, size);
+}
+
+void *mem_resize(Allocator *a, void *p, size_t old_size, size_t size) {
+  if (!a)
+    a = &heap_allocator;
+  if (size > old_size)
+    a->bytes += size - old_size;
+  a->calls++;
+  return a->resize(a, p, old_size, size);
+}
+
+void mem_release(Allocator *a, void *p) {
+  if (!a)
+    a = &heap_allocator;
+  a->release(a, p);
+}
+
+void allocator_reset_stats(Allocator *a) {
+  a->bytes = 0;
+  a->calls = 0;
+}
+
+Arena arena_create(size_t cap) {
+  Arena arena = {0};
+  arena.base = (Allocator){_arena_alloc, _arena_resize, _arena_release, 0, 0};
+  arena.data = malloc(cap);
+  arena.cap = arena.data ? cap : 0;
+  return arena;
+}
+
+void arena_destroy(Arena *arena) {
+  free(arena->data);
+  arena->data = NULL;
+  arena->cap = 0;
+}
+
+void arena_reset(Arena *arena) {
+  arena->used = 0;
+  arena->last = 0;
+}
+
+Pool pool_create(size_t block, unsigned int c_blocks) {
+  Pool pool = {0};
+  pool.base = (Allocator){_pool_alloc, _pool_resize, _pool_release, 0, 0};
+  pool.block = ((block > sizeof(void *) ? block : sizeof(void *)) + ALLOC_ALIGN - 1) & ~(size_t)(ALLOC_ALIGN - 1);
+  pool.data = malloc(pool.block * c_blocks);
+  if (pool.data == NULL)
+    return pool;
+  pool.c_blocks = c_blocks;
+  for (unsigned int i = c_blocks; i > 0; i--) { //lowest blocks are handed out first
+    void *p = pool.data + (i - 1) * pool.block;
+    *(void **)p = pool.free_list;
+    pool.free_list = p;
+  }
+  return pool;
+}
+
+void pool_destroy(Pool *pool) {
+  free(pool->data);
+  pool->data = NULL;
+  pool->free_list = NULL;
+  pool->c_blocks = 0;
+}
+
+unsigned int _memory_hash(const void *v, size_t size) {
+  //FNV-1a over the value's bytes
+  unsigned int h = 2166136261u;
+  for (size_t i = 0; i < size; i++)
+    h = (h ^ ((const unsigned char *)v)[i]) * 16777619u;
+  return h;
+}
+
+unsigned int _pointer_hash(const void *p) {
+  uint64_t h = (uintptr_t)p * 0x9e3779b97f4a7c15ull;
+  return (unsigned int)(h >> 32);
+}
+
+unsigned int _uqueue_hash(UQueue *q, void *v) {
+  return _memory_hash(v, q->size);
+}
+
+int _uqueue_find(UQueue *q, void *v) {
+  unsigned int mask = q->c_index - 1;
+  for (unsigned int i = _uqueue_hash(q, v) & mask; q->index[i] != 0; i = (i + 1) & mask)
+    if (memcmp(q->data + (q->index[i] - 1) * q->size, v, q->size) == 0)
+      return i;
+  return -1;
+}
+
+void _uqueue_unindex(UQueue *q, unsigned int slot) {
+  unsigned int mask = q->c_index - 1;
+  unsigned int i = _uqueue_hash(q, q->data + slot * q->size) & mask;
+  while (q->index[i] != slot + 1)
+    i = (i + 1) & mask;
+  //backward shift deletion keeps probe chains intact without tombstones
+  for (unsigned int j = (i + 1) & mask; q->index[j] != 0; j = (j + 1) & mask) {
+    unsigned int home = _uqueue_hash(q, q->data + (q->index[j] - 1) * q->size) & mask;
+    if (((j - home) & mask) >= ((j - i) & mask)) {
+      q->index[i] = q->index[j];
+      i = j;
+    }
+  }
+  q->index[i] = 0;
+}
 
 UQueue uqueue_create(unsigned int max, unsigned int size) {
+  return uqueue_create_mode(max, size, UQUEUE_UNIQUE);
+}
+
+UQueue uqueue_create_mode(unsigned int max, unsigned int size, UQueueMode mode) {
+  return uqueue_create_in(NULL, max, size, mode);
+}
+
+UQueue uqueue_create_in(Allocator *a, unsigned int max, unsigned int size, UQueueMode mode) {
   UQueue q;
   q.max = max;
   q.first = 0;
   q.len = 0;
   q.size = size;
-  q.data = malloc(max * size);
+  q.head = 0;
+  q.mode = mode;
+  q.c_index = 0;
+  q.index = 0;
+  q.alloc = a;
+  if (mode == UQUEUE_HASHED) {
+    q.c_index = 1;
+    while (q.c_index < max * 2)
+      q.c_index <<= 1;
+    q.index = mem_alloc(a, q.c_index * sizeof(unsigned int));
+    memset(q.index, 0, q.c_index * sizeof(unsigned int));
+  }
+  q.data = mem_alloc(a, max * size);
   return q;
 }
 
 void uqueue_destroy(UQueue *q) {
-  free(q->data);
+  mem_release(q->alloc, q->data);
+  if (q->index)
+    mem_release(q->alloc, q->index);
+}
+
+bool uqueue_contains(UQueue *q, void *v) {
+  if (q->index)
+    return _uqueue_find(q, v) >= 0;
+  for (unsigned int i = 0; i < q->len; i++)
+    if (memcmp(q->data + ((q->head + i) % q->max) * q->size, v, q->size) == 0)
+      return true;
+  return false;
 }
 
 bool uqueue_push(UQueue *q, void *v) {
+  if (q->mode != UQUEUE_FIFO && uqueue_contains(q, v))
+    return true;
   if (q->len == q->max)
     return false;
-  for (unsigned int i = 0; i < q->len; i++)
-    if (memcmp(q->data + (i * q->size), v, q->size) == 0)
-      return true;
-  memcpy(q->data + q->len * q->size, v, q->size);
+  unsigned int slot = (q->head + q->len) % q->max;
+  memcpy(q->data + slot * q->size, v, q->size);
   q->len++;
+  if (q->index) {
+    unsigned int mask = q->c_index - 1;
+    unsigned int i = _uqueue_hash(q, v) & mask;
+    while (q->index[i] != 0)
+      i = (i + 1) & mask;
+    q->index[i] = slot + 1;
+  }
   return true;
 }
 
 bool uqueue_pop(UQueue *q, void *v) {
   if (q->first == q->len)
     return false;
-  memcpy(v, q->data + q->first * q->size, q->size);
+  memcpy(v, q->data + ((q->head + q->first) % q->max) * q->size, q->size);
   q->first++;
+  if (q->mode == UQUEUE_FIFO)
+    uqueue_shift(q);
   return true;
 }
 
 void uqueue_reset(UQueue *q) {
+  if (q->index)
+    memset(q->index, 0, q->c_index * sizeof(unsigned int));
   q->first = 0;
   q->len = 0;
+  q->head = 0;
 }
 
 void uqueue_shift(UQueue *q) {
-  memmove(q->data, q->data + q->first * q->size, q->len * q->size);
+  if (q->index)
+    for (unsigned int i = 0; i < q->first; i++)
+      _uqueue_unindex(q, (q->head + i) % q->max);
+  if (q->max > 0)
+    q->head = (q->head + q->first) % q->max;
   q->len -= q->first;
   q->first = 0;
 }
@@ -99,107 +400,394 @@ void uqueue_restore(UQueue *q) {
 
 UQueue uqueue_copy(UQueue *q) {
   UQueue new_q = *q;
-  new_q.data = malloc(q->max * q->size);
-  memcpy(new_q.data + q->first * q->size, q->data + q->first * q->size, (q->len - q->first) * q->size);
+  new_q.data = mem_alloc(q->alloc, q->max * q->size);
+  memcpy(new_q.data, q->data, q->max * q->size);
+  if (q->index) {
+    new_q.index = mem_alloc(q->alloc, q->c_index * sizeof(unsigned int));
+    memcpy(new_q.index, q->index, q->c_index * sizeof(unsigned int));
+  }
   return new_q;
 }
 
-_BBranch *_bbranch_destroy(_BBranch *b) {
-  if (!b)
-    return 0;
-  if (b->left)
-    b->left = _bbranch_destroy(b->left);
-  if (b->right)
-    b->right = _bbranch_destroy(b->right);
-  if (b->value)
-    free(b->value);
-  free(b);
-  return 0;
-}
-
-_BBranch *_bbranch_push(_BBranch *b, float k, void *v, unsigned int size) {
-  if (!b) {
-    b = malloc(sizeof(_BBranch));
-    b->left = 0;
-    b->right = 0;
-    b->key = k;
-    b->value = malloc(size);
-    memcpy(b->value, v, size);
-  }
-  else if (k < b->key)
-    b->left = _bbranch_push(b->left, k, v, size);
-  else
-    b->right = _bbranch_push(b->right, k, v, size);
-  return b;
-}
-
-_BBranch *_bbranch_pop_low(_BBranch *b, void *v, unsigned int size) {
-  if (!b->left) {
-    memcpy(v, b->value, size);
-    _BBranch *new_b = b->right;
-    b->right = 0;
-    b = _bbranch_destroy(b);
-    return new_b;
+void _pqueue_swap(PQueue *q, unsigned int i, unsigned int j) {
+  float k = q->keys[i];
+  q->keys[i] = q->keys[j];
+  q->keys[j] = k;
+  //the spare slot at data[max] is the swap buffer
+  unsigned char *tmp = q->data + q->max * q->size;
+  memcpy(tmp, q->data + i * q->size, q->size);
+  memcpy(q->data + i * q->size, q->data + j * q->size, q->size);
+  memcpy(q->data + j * q->size, tmp, q->size);
+}
+
+unsigned int _pqueue_sift_up(PQueue *q, unsigned int i) {
+  while (i > 0 && q->keys[(i - 1) / 2] > q->keys[i]) {
+    _pqueue_swap(q, i, (i - 1) / 2);
+    i = (i - 1) / 2;
   }
-  b->left = _bbranch_pop_low(b->left, v, size);
-  return b;
+  return i;
 }
 
-_BBranch *_bbranch_pop_high(_BBranch *b, void *v, unsigned int size) {
-  if (!b->right) {
-    memcpy(v, b->value, size);
-    _BBranch *new_b = b->left;
-    b->left = 0;
-    b = _bbranch_destroy(b);
-    return new_b;
+void _pqueue_sift_down(PQueue *q, unsigned int i) {
+  while (true) {
+    unsigned int low = i;
+    unsigned int l = 2 * i + 1;
+    if (l < q->len && q->keys[l] < q->keys[low])
+      low = l;
+    if (l + 1 < q->len && q->keys[l + 1] < q->keys[low])
+      low = l + 1;
+    if (low == i)
+      return;
+    _pqueue_swap(q, i, low);
+    i = low;
   }
-  b->right = _bbranch_pop_high(b->right, v, size);
-  return b;
 }
 
-bool _bbranch_contains(_BBranch *b, float k, void *v, unsigned int size) {
-  if (!b)
-    return false;
-  if (k < b->key)
-    return _bbranch_contains(b->left, k, v, size);
-  if (k > b->key)
-    return _bbranch_contains(b->right, k, v, size);
-  if (memcmp(b->value, v, size) == 0)
-    return true;
-  return _bbranch_contains(b->right, k, v, size);
+PQueue pqueue_create(unsigned int max, unsigned int size) {
+  return pqueue_create_in(NULL, max, size);
 }
 
-BTree btree_create(unsigned int size) {
-  BTree t;
-  t.root = 0;
-  t.size = size;
-  return t;
+PQueue pqueue_create_in(Allocator *a, unsigned int max, unsigned int size) {
+  PQueue q;
+  q.max = max > 0 ? max : 1;
+  q.len = 0;
+  q.size = size;
+  q.alloc = a;
+  q.keys = mem_alloc(a, q.max * sizeof(float));
+  q.data = mem_alloc(a, (q.max + 1) * size);
+  return q;
 }
 
-void btree_destroy(BTree *t) {
-  _bbranch_destroy(t->root);
+void pqueue_destroy(PQueue *q) {
+  mem_release(q->alloc, q->data);
+  mem_release(q->alloc, q->keys);
 }
 
-void btree_push(BTree *t, float k, void *v) {
-  t->root = _bbranch_push(t->root, k, v, t->size);
+bool pqueue_push(PQueue *q, float k, void *v) {
+  if (q->len == q->max) {
+    //arena and pool allocators run out, keep the old arrays until both have grown
+    float *keys = mem_resize(q->alloc, q->keys, q->max * sizeof(float), q->max * 2 * sizeof(float));
+    if (keys == NULL)
+      return false;
+    q->keys = keys; //larger than max needs is harmless if data can't follow
+    unsigned char *data = mem_resize(q->alloc, q->data, (q->max + 1) * q->size, (q->max * 2 + 1) * q->size);
+    if (data == NULL)
+      return false;
+    q->data = data;
+    q->max *= 2;
+  }
+  q->keys[q->len] = k;
+  memcpy(q->data + q->len * q->size, v, q->size);
+  _pqueue_sift_up(q, q->len++);
+  return true;
 }
 
-bool btree_pop_low(BTree *t, void *v) {
-  if (!t->root)
+bool pqueue_pop_low(PQueue *q, void *v) {
+  if (q->len == 0)
     return false;
-  t->root = _bbranch_pop_low(t->root, v, t->size);
+  memcpy(v, q->data, q->size);
+  q->len--;
+  if (q->len > 0) {
+    q->keys[0] = q->keys[q->len];
+    memcpy(q->data, q->data + q->len * q->size, q->size);
+    _pqueue_sift_down(q, 0);
+  }
   return true;
 }
 
-bool btree_pop_high(BTree *t, void *v) {
-  if (!t->root)
+bool pqueue_pop_high(PQueue *q, void *v) {
+  if (q->len == 0)
     return false;
-  t->root = _bbranch_pop_high(t->root, v, t->size);
+  //the highest key is always a leaf, and leaves start halfway through the array
+  unsigned int high = q->len / 2;
+  for (unsigned int i = high + 1; i < q->len; i++)
+    if (q->keys[i] > q->keys[high])
+      high = i;
+  memcpy(v, q->data + high * q->size, q->size);
+  q->len--;
+  if (high < q->len) {
+    q->keys[high] = q->keys[q->len];
+    memcpy(q->data + high * q->size, q->data + q->len * q->size, q->size);
+    _pqueue_sift_up(q, high);
+  }
   return true;
 }
 
-bool btree_contains(BTree *t, float k, void *v) {
-  return _bbranch_contains(t->root, k, v, t->size);
+bool pqueue_contains(PQueue *q, float k, void *v) {
+  for (unsigned int i = 0; i < q->len; i++)
+    if (q->keys[i] == k && memcmp(q->data + i * q->size, v, q->size) == 0)
+      return true;
+  return false;
+}
+
+void pqueue_reset(PQueue *q) {
+  q->len = 0;
+}
+
+//Typed variants of the containers above, for small fixed types where the generic ones
+//runtime-size memcpy/memcmp get in the way. EQ(a, b) and HASH(v) take values of T.
+#define VALUE_EQ(a, b) ((a) == (b))
+#define MEMORY_EQ(a, b) (memcmp(&(a), &(b), sizeof(a)) == 0)
+#define POINTER_HASH(v) _pointer_hash(v)
+#define MEMORY_HASH(v) _memory_hash(&(v), sizeof(v))
+
+//Declares struct Name and prefix_* functions mirroring uqueue_*, with values passed as T.
+#define DECLARE_UQUEUE(Name, prefix, T, EQ, HASH) \
+typedef struct Name Name; \
+struct Name { \
+  unsigned int max; \
+  unsigned int first; \
+  unsigned int len; \
+  unsigned int head; \
+  UQueueMode mode; \
+  unsigned int c_index; \
+  unsigned int *index; \
+  T *data; \
+  Allocator *alloc; \
+}; \
+\
+int _##prefix##_find(Name *q, T v) { \
+  unsigned int mask = q->c_index - 1; \
+  for (unsigned int i = HASH(v) & mask; q->index[i] != 0; i = (i + 1) & mask) \
+    if (EQ(q->data[q->index[i] - 1], v)) \
+      return i; \
+  return -1; \
+} \
+\
+void _##prefix##_unindex(Name *q, unsigned int slot) { \
+  unsigned int mask = q->c_index - 1; \
+  unsigned int i = HASH(q->data[slot]) & mask; \
+  while (q->index[i] != slot + 1) \
+    i = (i + 1) & mask; \
+  for (unsigned int j = (i + 1) & mask; q->index[j] != 0; j = (j + 1) & mask) { \
+    unsigned int home = HASH(q->data[q->index[j] - 1]) & mask; \
+    if (((j - home) & mask) >= ((j - i) & mask)) { \
+      q->index[i] = q->index[j]; \
+      i = j; \
+    } \
+  } \
+  q->index[i] = 0; \
+} \
+\
+Name prefix##_create_in(Allocator *a, unsigned int max, UQueueMode mode) { \
+  Name q = {0}; \
+  q.max = max; \
+  q.mode = mode; \
+  q.alloc = a; \
+  if (mode == UQUEUE_HASHED) { \
+    q.c_index = 1; \
+    while (q.c_index < max * 2) \
+      q.c_index <<= 1; \
+    q.index = mem_alloc(a, q.c_index * sizeof(unsigned int)); \
+    memset(q.index, 0, q.c_index * sizeof(unsigned int)); \
+  } \
+  q.data = mem_alloc(a, max * sizeof(T)); \
+  return q; \
+} \
+\
+Name prefix##_create(unsigned int max, UQueueMode mode) { \
+  return prefix##_create_in(NULL, max, mode); \
+} \
+\
+void prefix##_destroy(Name *q) { \
+  mem_release(q->alloc, q->data); \
+  if (q->index) \
+    mem_release(q->alloc, q->index); \
+} \
+\
+bool prefix##_contains(Name *q, T v) { \
+  if (q->index) \
+    return _##prefix##_find(q, v) >= 0; \
+  for (unsigned int i = 0, slot = q->head; i < q->len; i++, slot = slot + 1 == q->max ? 0 : slot + 1) \
+    if (EQ(q->data[slot], v)) \
+      return true; \
+  return false; \
+} \
+\
+void prefix##_shift(Name *q) { \
+  if (q->index) \
+    for (unsigned int i = 0; i < q->first; i++) \
+      _##prefix##_unindex(q, (q->head + i) % q->max); \
+  if (q->max > 0) \
+    q->head = (q->head + q->first) % q->max; \
+  q->len -= q->first; \
+  q->first = 0; \
+} \
+\
+bool prefix##_push(Name *q, T v) { \
+  if (q->mode != UQUEUE_FIFO && prefix##_contains(q, v)) \
+    return true; \
+  if (q->len == q->max) \
+    return false; \
+  unsigned int slot = q->head + q->len; \
+  if (slot >= q->max) \
+    slot -= q->max; \
+  q->data[slot] = v; \
+  q->len++; \
+  if (q->index) { \
+    unsigned int mask = q->c_index - 1; \
+    unsigned int i = HASH(v) & mask; \
+    while (q->index[i] != 0) \
+      i = (i + 1) & mask; \
+    q->index[i] = slot + 1; \
+  } \
+  return true; \
+} \
+\
+bool prefix##_pop(Name *q, T *v) { \
+  if (q->first == q->len) \
+    return false; \
+  unsigned int slot = q->head + q->first; \
+  if (slot >= q->max) \
+    slot -= q->max; \
+  *v = q->data[slot]; \
+  q->first++; \
+  if (q->mode == UQUEUE_FIFO) \
+    prefix##_shift(q); \
+  return true; \
+} \
+\
+void prefix##_reset(Name *q) { \
+  if (q->index) \
+    memset(q->index, 0, q->c_index * sizeof(unsigned int)); \
+  q->first = 0; \
+  q->len = 0; \
+  q->head = 0; \
+} \
+\
+void prefix##_restore(Name *q) { \
+  q->first = 0; \
+} \
+\
+Name prefix##_copy(Name *q) { \
+  Name new_q = *q; \
+  new_q.data = mem_alloc(q->alloc, q->max * sizeof(T)); \
+  memcpy(new_q.data, q->data, q->max * sizeof(T)); \
+  if (q->index) { \
+    new_q.index = mem_alloc(q->alloc, q->c_index * sizeof(unsigned int)); \
+    memcpy(new_q.index, q->index, q->c_index * sizeof(unsigned int)); \
+  } \
+  return new_q; \
+}
+
+//Declares struct Name and prefix_* functions mirroring pqueue_*, with values passed as T.
+#define DECLARE_PQUEUE(Name, prefix, T, EQ) \
+typedef struct Name Name; \
+struct Name { \
+  unsigned int max; \
+  unsigned int len; \
+  float *keys; \
+  T *data; \
+  Allocator *alloc; \
+}; \
+\
+void _##prefix##_swap(Name *q, unsigned int i, unsigned int j) { \
+  float k = q->keys[i]; \
+  q->keys[i] = q->keys[j]; \
+  q->keys[j] = k; \
+  T v = q->data[i]; \
+  q->data[i] = q->data[j]; \
+  q->data[j] = v; \
+} \
+\
+unsigned int _##prefix##_sift_up(Name *q, unsigned int i) { \
+  while (i > 0 && q->keys[(i - 1) / 2] > q->keys[i]) { \
+    _##prefix##_swap(q, i, (i - 1) / 2); \
+    i = (i - 1) / 2; \
+  } \
+  return i; \
+} \
+\
+void _##prefix##_sift_down(Name *q, unsigned int i) { \
+  while (true) { \
+    unsigned int low = i; \
+    unsigned int l = 2 * i + 1; \
+    if (l < q->len && q->keys[l] < q->keys[low]) \
+      low = l; \
+    if (l + 1 < q->len && q->keys[l + 1] < q->keys[low]) \
+      low = l + 1; \
+    if (low == i) \
+      return; \
+    _##prefix##_swap(q, i, low); \
+    i = low; \
+  } \
+} \
+\
+Name prefix##_create_in(Allocator *a, unsigned int max) { \
+  Name q = {0}; \
+  q.max = max > 0 ? max : 1; \
+  q.alloc = a; \
+  q.keys = mem_alloc(a, q.max * sizeof(float)); \
+  q.data = mem_alloc(a, q.max * sizeof(T)); \
+  return q; \
+} \
+\
+Name prefix##_create(unsigned int max) { \
+  return prefix##_create_in(NULL, max); \
+} \
+\
+void prefix##_destroy(Name *q) { \
+  mem_release(q->alloc, q->data); \
+  mem_release(q->alloc, q->keys); \
+} \
+\
+bool prefix##_push(Name *q, float k, T v) { \
+  if (q->len == q->max) { \
+    float *keys = mem_resize(q->alloc, q->keys, q->max * sizeof(float), q->max * 2 * sizeof(float)); \
+    if (keys == NULL) \
+      return false; \
+    q->keys = keys; \
+    T *data = mem_resize(q->alloc, q->data, q->max * sizeof(T), q->max * 2 * sizeof(T)); \
+    if (data == NULL) \
+      return false; \
+    q->data = data; \
+    q->max *= 2; \
+  } \
+  q->keys[q->len] = k; \
+  q->data[q->len] = v; \
+  _##prefix##_sift_up(q, q->len++); \
+  return true; \
+} \
+\
+bool prefix##_pop_low(Name *q, T *v) { \
+  if (q->len == 0) \
+    return false; \
+  *v = q->data[0]; \
+  q->len--; \
+  if (q->len > 0) { \
+    q->keys[0] = q->keys[q->len]; \
+    q->data[0] = q->data[q->len]; \
+    _##prefix##_sift_down(q, 0); \
+  } \
+  return true; \
+} \
+\
+bool prefix##_pop_high(Name *q, T *v) { \
+  if (q->len == 0) \
+    return false; \
+  unsigned int high = q->len / 2; \
+  for (unsigned int i = high + 1; i < q->len; i++) \
+    if (q->keys[i] > q->keys[high]) \
+      high = i; \
+  *v = q->data[high]; \
+  q->len--; \
+  if (high < q->len) { \
+    q->keys[high] = q->keys[q->len]; \
+    q->data[high] = q->data[q->len]; \
+    _##prefix##_sift_up(q, high); \
+  } \
+  return true; \
+} \
+\
+bool prefix##_contains(Name *q, float k, T v) { \
+  for (unsigned int i = 0; i < q->len; i++) \
+    if (q->keys[i] == k && EQ(q->data[i], v)) \
+      return true; \
+  return false; \
+} \
+\
+void prefix##_reset(Name *q) { \
+  q->len = 0; \
 }
 
 #endif
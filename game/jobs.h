@@ -0,0 +1,234 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "profiler.h"
+
+//Work-stealing job system. Each thread that runs jobs owns a deque and takes its newest job
+//from the bottom; a thread with nothing left steals the oldest job from the top of another's.
+//With JOB_WORKERS 0 (the web default) or before job_system_start, jobs run inline as submitted.
+#ifndef JOB_WORKERS
+  #ifdef PLATFORM_WEB
+    #define JOB_WORKERS 0
+  #else
+    #define JOB_WORKERS 7 //most workers job_system_start will make
+  #endif
+#endif
+#if JOB_WORKERS > 0
+  #include <pthread.h>
+  #include <unistd.h>
+#endif
+
+#define JOB_DEQUE_SIZE 64 //power of two, jobs that don't fit run inline
+#define JOB_PROF_THREAD 16 //profiler thread index of the first worker, clear of the other threads
+
+typedef struct Job Job;
+typedef struct JobCounter JobCounter;
+typedef struct JobDeque JobDeque;
+typedef struct JobSystem JobSystem;
+
+typedef void (*JobFunc)(void *data, int start, int end);
+
+struct JobCounter {
+  int pending; //jobs submitted against it that haven't finished, only touched atomically
+};
+
+struct Job {
+  JobFunc func; //Runs the job over [start, end).
+  void *data;
+  int start;
+  int end;
+  JobCounter *counter;
+};
+
+struct JobDeque {
+#if JOB_WORKERS > 0
+  pthread_mutex_t lock;
+#endif
+  Job jobs[JOB_DEQUE_SIZE];
+  unsigned int top; //oldest, where thieves take from
+  unsigned int bottom; //one past the newest, where the owner pushes and pops
+};
+
+struct JobSystem {
+  JobDeque deques[JOB_WORKERS + 1]; //0 belongs to the thread submitting from outside the workers
+#if JOB_WORKERS > 0
+  pthread_t threads[JOB_WORKERS];
+  pthread_mutex_t lock;
+  pthread_cond_t wake; //jobs were queued or the workers should quit
+#endif
+  int c_workers; //deques past 0 that jobs are stolen from
+  int c_threads; //workers actually running
+  unsigned int c_queued; //jobs sitting in any deque, only touched atomically
+  bool quit;
+};
+
+JobSystem job_system = {0};
+_Thread_local int job_self = 0; //index of the calling thread's deque
+
+int job_cpu_count(); //Returns how many cores are online, at least 1.
+void job_system_start(int c_workers); //Starts up to JOB_WORKERS workers, 0 keeps every job inline.
+void job_system_stop(); //Joins the workers, every submitted job must have been waited for.
+void job_submit(JobFunc func, void *data, int start, int end, JobCounter *counter); //Queues a job on the caller's deque, counted by counter until it has run.
+bool job_run_one(); //Runs the caller's newest job or steals another thread's oldest, false when every deque was empty.
+void job_wait(JobCounter *counter); //Runs jobs until every job counted by counter has finished.
+void job_parallel_for(JobFunc func, void *data, int count, int grain); //Splits [0, count) into ranges of grain, spreads them over the workers and waits.
+void job_run(Job *job); //Runs a job and releases its counter.
+bool job_deque_push(JobDeque *d, Job *job); //Adds a job at the bottom, false when full.
+bool job_deque_pop(JobDeque *d, Job *job); //Takes the newest job.
+bool job_deque_steal(JobDeque *d, Job *job); //Takes the oldest job.
+void *job_worker(void *arg); //Worker thread loop, runs and steals jobs until the system stops.
+
+int job_cpu_count() {
+#if JOB_WORKERS > 0
+  long c = sysconf(_SC_NPROCESSORS_ONLN);
+  return c > 1 ? c : 1;
+#else
+  return 1;
+#endif
+}
+
+void job_run(Job *job) {
+  job->func(job->data, job->start, job->end);
+  __atomic_sub_fetch(&job->counter->pending, 1, __ATOMIC_RELEASE);
+}
+
+#if JOB_WORKERS > 0
+bool job_deque_push(JobDeque *d, Job *job) {
+  pthread_mutex_lock(&d->lock);
+  bool pushed = d->bottom - d->top < JOB_DEQUE_SIZE;
+  if (pushed)
+    d->jobs[d->bottom++ & (JOB_DEQUE_SIZE - 1)] = *job;
+  pthread_mutex_unlock(&d->lock);
+  return pushed;
+}
+
+bool job_deque_pop(JobDeque *d, Job *job) {
+  pthread_mutex_lock(&d->lock);
+  bool popped = d->bottom != d->top;
+  if (popped)
+    *job = d->jobs[--d->bottom & (JOB_DEQUE_SIZE - 1)];
+  pthread_mutex_unlock(&d->lock);
+  return popped;
+}
+
+bool job_deque_steal(JobDeque *d, Job *job) {
+  pthread_mutex_lock(&d->lock);
+  bool stolen = d->bottom != d->top;
+  if (stolen)
+    *job = d->jobs[d->top++ & (JOB_DEQUE_SIZE - 1)];
+  pthread_mutex_unlock(&d->lock);
+  return stolen;
+}
+
+void *job_worker(void *arg) {
+  job_self = (intptr_t)arg;
+  PROF_SET_THREAD(JOB_PROF_THREAD + job_self - 1);
+  while (true) {
+    if (job_run_one())
+      continue;
+    pthread_mutex_lock(&job_system.lock);
+    while (!job_system.quit && __atomic_load_n(&job_system.c_queued, __ATOMIC_ACQUIRE) == 0)
+      pthread_cond_wait(&job_system.wake, &job_system.lock);
+    bool quit = job_system.quit;
+    pthread_mutex_unlock(&job_system.lock);
+    if (quit)
+      break;
+  }
+  return NULL;
+}
+#endif
+
+void job_system_start(int c_workers) {
+#if JOB_WORKERS > 0
+  c_workers = c_workers < JOB_WORKERS ? c_workers : JOB_WORKERS;
+  pthread_mutex_init(&job_system.lock, NULL);
+  pthread_cond_init(&job_system.wake, NULL);
+  for (int i = 0; i <= JOB_WORKERS; i++) {
+    pthread_mutex_init(&job_system.deques[i].lock, NULL);
+    job_system.deques[i].top = job_system.deques[i].bottom = 0;
+  }
+  job_system.c_queued = 0;
+  job_system.quit = false;
+  //set before any worker reads it; deques of workers that fail to start just stay empty
+  job_system.c_workers = c_workers;
+  job_system.c_threads = 0;
+  for (int i = 0; i < c_workers; i++) {
+    if (pthread_create(job_system.threads + i, NULL, job_worker, (void *)(intptr_t)(i + 1)) != 0)
+      break;
+    job_system.c_threads++;
+  }
+#endif
+}
+
+void job_system_stop() {
+#if JOB_WORKERS > 0
+  pthread_mutex_lock(&job_system.lock);
+  job_system.quit = true;
+  pthread_cond_broadcast(&job_system.wake);
+  pthread_mutex_unlock(&job_system.lock);
+  for (int i = 0; i < job_system.c_threads; i++)
+    pthread_join(job_system.threads[i], NULL);
+  for (int i = 0; i <= JOB_WORKERS; i++)
+    pthread_mutex_destroy(&job_system.deques[i].lock);
+  pthread_mutex_destroy(&job_system.lock);
+  pthread_cond_destroy(&job_system.wake);
+  job_system.c_workers = 0;
+#endif
+}
+
+void job_submit(JobFunc func, void *data, int start, int end, JobCounter *counter) {
+  Job job = {func, data, start, end, counter};
+  __atomic_add_fetch(&counter->pending, 1, __ATOMIC_RELAXED);
+#if JOB_WORKERS > 0
+  if (job_system.c_workers > 0) {
+    //counted before it is visible so a thief can't take it and drop c_queued below zero
+    __atomic_add_fetch(&job_system.c_queued, 1, __ATOMIC_RELEASE);
+    if (job_deque_push(job_system.deques + job_self, &job)) {
+      pthread_mutex_lock(&job_system.lock);
+      pthread_cond_signal(&job_system.wake);
+      pthread_mutex_unlock(&job_system.lock);
+      return;
+    }
+    __atomic_sub_fetch(&job_system.c_queued, 1, __ATOMIC_RELAXED);
+  }
+#endif
+  job_run(&job);
+}
+
+bool job_run_one() {
+#if JOB_WORKERS > 0
+  Job job;
+  bool found = job_deque_pop(job_system.deques + job_self, &job);
+  for (int i = 1; !found && i <= job_system.c_workers; i++)
+    found = job_deque_steal(job_system.deques + (job_self + i) % (job_system.c_workers + 1), &job);
+  if (!found)
+    return false;
+  __atomic_sub_fetch(&job_system.c_queued, 1, __ATOMIC_RELAXED);
+  job_run(&job);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void job_wait(JobCounter *counter) {
+  //help instead of sleeping, the jobs this waits on are short
+  while (__atomic_load_n(&counter->pending, __ATOMIC_ACQUIRE) > 0)
+    job_run_one();
+}
+
+void job_parallel_for(JobFunc func, void *data, int count, int grain) {
+  if (job_system.c_workers == 0 || count <= grain) {
+    if (count > 0)
+      func(data, 0, count);
+    return;
+  }
+  JobCounter counter = {0};
+  for (int start = 0; start < count; start += grain)
+    job_submit(func, data, start, start + grain < count ? start + grain : count, &counter);
+  job_wait(&counter);
+}
+
+#endif
@@ -4,16 +4,38 @@
 #include <string.h>
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"
 
 #include "datstructs.h"
 #include "symath.h"
 #include "models.h"
-#include "maps.h"
+#include "mappack.h"
+#include "profiler.h"
+#include "jobs.h"
+#include "replay.h"
 
 #ifdef PLATFORM_WEB
   #include <emscripten/emscripten.h>
 #endif
 
+#ifndef MESH_WORKERS
+  #ifdef PLATFORM_WEB
+    #define MESH_WORKERS 0 //chunks are meshed on the main thread
+  #else
+    #define MESH_WORKERS 3
+  #endif
+#endif
+#ifndef SIM_THREAD
+  #ifdef PLATFORM_WEB
+    #define SIM_THREAD 0 //simulation always runs inline before drawing
+  #else
+    #define SIM_THREAD 1 //simulation can run on its own thread, see sim_pipelined
+  #endif
+#endif
+#if MESH_WORKERS > 0 || SIM_THREAD
+  #include <pthread.h>
+#endif
+
 #ifdef PLATFORM_DESKTOP
   #define GLSL_VERSION            330
 #else //PLATFORM_ANDROID, PLATFORM_WEB
@@ -37,6 +59,11 @@
 
 #define FPS 0
 #define TPS 2.0f
+#ifndef SIM_HZ
+  #define SIM_HZ 60 //fixed simulation rate, independent of FPS
+#endif
+#define SIM_STEP (1.0f / SIM_HZ)
+#define SIM_MAX_STEPS 4 //catch-up steps per frame, slower frames drop the rest of their time
 
 #define COLOR_DEPTH_R 16
 #define COLOR_DEPTH_G 16
@@ -52,12 +79,29 @@
 #define CHUNK_SIZE 16
 #define CHUNK_SIZE_S (CHUNK_SIZE * CHUNK_SIZE)
 #define CHUNK_HEIGHT_CAP 10000.0f
-#define MAX_ACTIVE_CHUNKS 41
+#define MAX_LOADED_CHUNKS 128 //memory cap of the chunk cache
+#define CHUNK_MAP_SIZE 256 //hash slots, power of two well above MAX_LOADED_CHUNKS
+#define CHUNK_LOAD_RADIUS 4 //chunks kept loaded around the followed object, (2r + 1)^2 <= MAX_LOADED_CHUNKS
+#define MAX_ACTIVE_CHUNKS ((2 * CHUNK_LOAD_RADIUS + 1) * (2 * CHUNK_LOAD_RADIUS + 1))
+#define MAX_RETIRED_MESHES (SIM_MAX_STEPS * MAX_ACTIVE_CHUNKS) //evictions one batch of steps can make before the main thread unloads them
+#define MAX_CHUNK_QUADS (CHUNK_SIZE_S * 3)
+#define TILE_VERTICES 12 //top, west and north wall quads owned by each tile of an editable chunk
+#define MAX_DIRTY_CHUNKS 64
+#define MAP_PACK_PATH "./res/maps/test.pack"
+#define MAX_MESH_JOBS 64
+#define MESH_UPLOADS_PER_FRAME 4
+#define TERRAIN_Y_SCALE 256.0f //fixed point scale of TerrainVertex y, must match the terrain vertex shaders
+#define TERRAIN_Y_LIMIT (32767.0f / TERRAIN_Y_SCALE) //a short holds heights within about ±128, pack_quad clamps the rest
+#ifndef RL_SHORT
+  #define RL_SHORT 0x1402 //GL_SHORT, not exported by rlgl
+#endif
 
 #define MAX_NAME_LENGTH 20
 #define MAX_FACINGS 8
 #define MAX_ANIMATIONS 16
 #define STEP_SNAP_HEIGHT 0.5f
+#define MAX_PUSHERS (4 * 9)
+#define MAX_SWEEP_EVENTS 16
 #define GRAVITY 20.0f
 
 #define MAX_USABLE_ITEMS 4
@@ -67,13 +111,42 @@
 
 #define MAX_ACTIVE_NPCS 256
 #define MAX_INACTIVE_NPCS 2048
+#define MAX_NPCS (MAX_ACTIVE_NPCS + MAX_INACTIVE_NPCS)
+#define NPC_SLOT_BITS 12 //handle bits holding the slot, 1 << NPC_SLOT_BITS >= MAX_NPCS
+#define NPC_ANIMATION_SPEED 10.0f //animation frames per second while walking
+#define NPC_JOB_GRAIN 32 //active NPCs per job in the update pass
+#define NPC_MAX_RADIUS 0.5f //largest NPC radius the grid queries reach for
+#define NPC_GRID_CELL 1.0f //tiles per grid cell side, at least 2 * NPC_MAX_RADIUS so push-out only looks one cell around
+#define NPC_GRID_BUCKETS 16384 //power of two, several times MAX_NPCS so bucket lists stay short
+#define NPC_MAX_NEAREST 16 //most NPCs one k-nearest query returns
+#define NPC_ACTIVATE_RADIUS 2 //chunks around the player's chunk that wake inactive NPCs
+#define NPC_DEACTIVATE_RADIUS 3 //chunks past which active NPCs go dormant, below CHUNK_LOAD_RADIUS so active ones stand on loaded chunks
+#define NPC_ACTIVATION_BUDGET 8 //NPCs moved between the ranges per update
+#define NPC_ACTIVATION_SCAN 128 //NPCs of each range checked per update
+
+#define FRAME_ARENA_SIZE (1 << 20) //scratch memory that lives until the next frame
+
+#define RNG_SEED 0x5eedu
 
 typedef struct Basic3D Basic3D;
 typedef struct Basic2D Basic2D;
 typedef struct Input Input;
 typedef struct CamPoint CamPoint;
+typedef struct SimState SimState;
+typedef struct RenderChunk RenderChunk;
+typedef struct FrameState FrameState;
+typedef struct SimWorker SimWorker;
 typedef struct Pusher Pusher;
+typedef struct PusherLanes PusherLanes;
+typedef struct TerrainVertex TerrainVertex;
+typedef struct TerrainMesh TerrainMesh;
+typedef struct MeshSource MeshSource;
+typedef struct MeshRequest MeshRequest;
+typedef struct MeshJob MeshJob;
+typedef struct MeshPool MeshPool;
 typedef struct WorldChunk WorldChunk;
+typedef struct ChunkCache ChunkCache;
+typedef struct ActiveChunks ActiveChunks;
 typedef struct StaticObject StaticObject;
 typedef struct Animation Animation;
 typedef struct GameObject GameObject;
@@ -81,6 +154,10 @@ typedef struct CombatObject CombatObject;
 typedef struct PCObject PCObject;
 typedef struct PlayerObject PlayerObject;
 typedef struct NPCObject NPCObject;
+typedef struct NPCStats NPCStats;
+typedef struct NPCStore NPCStore;
+typedef struct NPCGrid NPCGrid;
+typedef struct NPCPair NPCPair;
 typedef struct ObjectKeeper ObjectKeeper;
 
 typedef enum {
@@ -90,6 +167,20 @@ typedef enum {
   CARDINAL_WEST
 } Cardinals;
 
+typedef enum {
+  FACE_UP = 0,
+  FACE_NORTH,
+  FACE_EAST,
+  FACE_SOUTH,
+  FACE_WEST
+} TerrainFace;
+
+const unsigned short quad_orders[][6] = {
+  {0, 1, 2, 3, 2, 1}, //top
+  {0, 1, 2, 2, 3, 0}, //west wall
+  {0, 1, 2, 3, 0, 2}  //north wall
+};
+
 struct Basic3D {
   Shader shader;
   int light_src_loc;
@@ -109,6 +200,8 @@ struct Input {
   float cam_rotate;
   float cam_rotate_v;
   float zoom_factor;
+  bool jetpack;
+  float terrain_edit;
 };
 
 struct CamPoint {
@@ -124,6 +217,13 @@ struct CamPoint {
   GameObject *follow_obj;
 };
 
+struct SimState {
+  Vector3 object_pos;
+  Vector3 cam_position;
+  Vector3 cam_target;
+  float cam_fovy;
+};
+
 struct Pusher {
   Vector2 v1;
   Vector2 v2;
@@ -132,15 +232,109 @@ struct Pusher {
   float h;
 };
 
-struct WorldChunk {
+//The tile edges around a settling object, pusher tile * 4 + edge (NESW), for closest_points_on_lines
+//and unclipping_vectors.
+struct PusherLanes {
+  float v1_x[MAX_PUSHERS];
+  float v1_y[MAX_PUSHERS];
+  float v2_x[MAX_PUSHERS];
+  float v2_y[MAX_PUSHERS];
+  float p_x[MAX_PUSHERS]; //closest points to the position the lanes were last updated for
+  float p_y[MAX_PUSHERS];
+  float dist_sqr[MAX_PUSHERS];
+  float dir_x[MAX_PUSHERS]; //edge push direction
+  float dir_y[MAX_PUSHERS];
+  float push_x[MAX_PUSHERS]; //unclipping vectors for the same position
+  float push_y[MAX_PUSHERS];
+  float h[MAX_PUSHERS];
+};
+
+struct TerrainVertex {
+  short x, y, z; //local tile coordinates, y in 1/TERRAIN_Y_SCALE steps
+  short face; //TerrainFace, decoded to a normal by the shader
+};
+
+struct TerrainMesh {
+  int c_vertices;
+  int c_indices;
+  TerrainVertex *vertices; //NULL once released after upload
+  unsigned short *indices;
+  unsigned int vao;
+  unsigned int vbo;
+  unsigned int ebo;
+  bool fixed_layout; //TILE_VERTICES per tile in index order, for partial updates
+};
+
+struct MeshSource {
   float height_map[CHUNK_SIZE_S];
+  float west[CHUNK_SIZE]; //east column of the west neighbour, NAN without one
+  float north[CHUNK_SIZE]; //south row of the north neighbour, NAN without one
+  float max_height;
+  bool editable;
+};
+
+struct MeshRequest {
+  WorldChunk *chunk; //where the mesh goes, workers never dereference it
+  MeshSource source;
+};
+
+struct MeshJob {
+  WorldChunk *chunk;
+  TerrainMesh mesh;
+};
+
+DECLARE_UQUEUE(ChunkQueue, chunk_queue, WorldChunk *, VALUE_EQ, POINTER_HASH)
+DECLARE_UQUEUE(MeshRequestQueue, mesh_request_queue, MeshRequest, MEMORY_EQ, MEMORY_HASH)
+DECLARE_UQUEUE(MeshJobQueue, mesh_job_queue, MeshJob, MEMORY_EQ, MEMORY_HASH)
+
+struct MeshPool {
+  MeshRequestQueue pending; //chunk copies waiting for a worker
+  MeshJobQueue done; //waiting for upload on the main thread
+#if MESH_WORKERS > 0
+  pthread_t threads[MESH_WORKERS];
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  int in_flight; //popped from pending and still being built, each has a place reserved in done
+  bool quit;
+#endif
+};
+
+struct WorldChunk {
+  const float *height_map; //height_data, or the map pack until the chunk is first edited
+  float height_data[CHUNK_SIZE_S];
   float max_height;
   float min_height;
   int w_pos[2];
   WorldChunk *neighbours[4]; //NESW
-  Mesh mesh;
-  Model model;
+  bool editable; //keeps CPU-side mesh arrays after upload
+  unsigned short dirty_rows[CHUNK_SIZE]; //bit per tile waiting to be re-meshed
+  bool mesh_stale; //needs a (re)mesh, requested when next drawn
+  bool meshing; //a copy is queued on or being meshed by the pool, must not be evicted
+  unsigned int visit_epoch; //ActiveChunks epoch the chunk was last collected in
+  unsigned int render_epoch; //frame_epoch the chunk was last pinned for drawing in, must not be evicted while it matches
+  TerrainMesh mesh;
   Color tint;
+  WorldChunk *lru_prev;
+  WorldChunk *lru_next;
+};
+
+struct ChunkCache {
+  WorldChunk chunks[MAX_LOADED_CHUNKS];
+  short map[CHUNK_MAP_SIZE]; //chunk index + 1 by hashed w_pos, 0 when empty
+  int c_chunks;
+  WorldChunk *lru_first; //most recently used
+  WorldChunk *lru_last;
+  int center[2]; //w_pos chunks were last streamed around
+  unsigned int generation; //bumped whenever a chunk is loaded or evicted
+};
+
+struct ActiveChunks {
+  WorldChunk *chunks[MAX_ACTIVE_CHUNKS]; //nearest first
+  int c_chunks;
+  int center[2];
+  int radius;
+  unsigned int generation; //chunk_cache.generation the set was collected at
+  unsigned int epoch;
 };
 
 struct StaticObject {
@@ -212,21 +406,178 @@ struct NPCObject {
   void (*combat_ai)(NPCObject *);
 };
 
+typedef unsigned int NPCHandle; //slot in the low NPC_SLOT_BITS, the slot's generation above, 0 is never live
+
+typedef enum {
+  NPC_SETTLED = 1 << 0, //resting on the ground, movement skips it until it gets a velocity or a turn passes
+  NPC_DORMANT_MOVED = 1 << 1 //walked while inactive without terrain, its height is stale until it wakes
+} NPCFlags;
+
+struct NPCStats {
+  float hp, mp, ap, ep;
+  short level;
+  short atk, acc, mag, def, mdf, spd;
+};
+
+//Structure of arrays for NPCs. Columns are indexed densely: active NPCs fill [0, c_active) and
+//inactive ones [MAX_ACTIVE_NPCS, MAX_ACTIVE_NPCS + c_inactive), so batched passes walk contiguous
+//floats. Handles stay valid while NPCs move between ranges; the columns hold the live position,
+//the cold NPCObject keeps only what the simulation does not touch every step.
+struct NPCStore {
+  float pos_x[MAX_NPCS];
+  float pos_y[MAX_NPCS];
+  float pos_z[MAX_NPCS];
+  float vel_x[MAX_NPCS]; //tiles per second
+  float vel_z[MAX_NPCS];
+  float dir_x[MAX_NPCS]; //last move direction, for facings
+  float dir_z[MAX_NPCS];
+  float radius[MAX_NPCS];
+  float g_speed[MAX_NPCS];
+  unsigned char flags[MAX_NPCS];
+  unsigned char animation_index[MAX_NPCS];
+  float frame_index[MAX_NPCS];
+  NPCStats stats[MAX_NPCS];
+  NPCObject *cold[MAX_NPCS]; //from npc_pool
+  NPCHandle handle[MAX_NPCS]; //dense index to handle
+  unsigned short dense[MAX_NPCS]; //slot to dense index
+  unsigned int generation[MAX_NPCS]; //per slot, bumped on destroy
+  unsigned short free_slots[MAX_NPCS];
+  float push_x[MAX_NPCS]; //separation from overlapping neighbours, only valid during update_npcs
+  float push_z[MAX_NPCS];
+  int c_free_slots;
+  int c_active;
+  int c_inactive;
+  int wake_cursor; //offset into the inactive range the activation manager checks next
+  int sleep_cursor; //active index it checks next
+};
+
+//Uniform grid of NPC_GRID_CELL cells over the unbounded world, hashed into a fixed set of buckets.
+//Every NPC is linked into the list of the cell it stands in, by slot so column moves leave it alone,
+//and only gets relinked when it crosses into another cell.
+struct NPCGrid {
+  unsigned short head[NPC_GRID_BUCKETS]; //slot + 1 of the bucket's first NPC, 0 when empty
+  unsigned short next[MAX_NPCS]; //per slot, slot + 1 of the next NPC in its bucket
+  unsigned short prev[MAX_NPCS]; //per slot, slot + 1 of the previous one, 0 at the head
+  int cell_x[MAX_NPCS]; //per slot, buckets mix cells so queries compare these
+  int cell_z[MAX_NPCS];
+};
+
+struct NPCPair {
+  NPCHandle a;
+  NPCHandle b;
+};
+
 struct ObjectKeeper {
   PlayerObject player;
-  UQueue active_npcs;
-  UQueue inactive_npcs;
+  Pool npc_pool; //cold NPCObject storage
+  NPCStore npcs;
+  NPCGrid npc_grid;
+};
+
+struct RenderChunk {
+  WorldChunk *chunk; //pinned while drawn, only its mesh, w_pos and tint are read
+  float min_y; //height bounds including the walls down to the west and north neighbours
+  float max_y;
+};
+
+//Everything drawing reads from the simulation, copied at the end of each batch of steps.
+struct FrameState {
+  SimState prev; //before the batch's last step, for interpolation
+  SimState state;
+  GameObject object;
+  CamPoint cam_point;
+  RenderChunk chunks[MAX_ACTIVE_CHUNKS]; //active chunks, nearest first
+  int c_chunks;
+  bool next_turn;
+};
+
+struct SimWorker {
+#if SIM_THREAD
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake; //a batch was requested or the worker should quit
+  pthread_cond_t done; //the batch finished
+  int c_steps;
+  bool busy; //steps are running, main must not touch simulation state
+  bool quit;
+#endif
+  bool running;
 };
 
 int get_screen_width(); //Wrapped GetScreenWidth for better fullscreen compatibility.
 int get_screen_height(); //Wrapped GetScreenHeight for better fullscreen compatibility.
 Color color_d(unsigned char r, unsigned char g, unsigned char b, unsigned char a); //Returns color with applied depth.
-float *generate_chunk_vertices(WorldChunk *chunk, int *c_vertices); //Generates vertices from a WorldChunk height map.
+void rng_seed(unsigned int seed); //Reset the deterministic random number generator.
+unsigned int rng_next(); //Returns the next xorshift value, used in place of rand().
+float rng_float(); //Returns a random float in [0, 1].
+unsigned int rng_step(unsigned int *state); //Advances a caller-owned xorshift state and returns it.
+float rng_step_float(unsigned int *state); //Returns a random float in [0, 1] from a caller-owned state.
+float *generate_chunk_vertices(WorldChunk *chunk, int *c_vertices, Allocator *a); //Generates vertices from a WorldChunk height map.
 WorldChunk *get_chunk_at(WorldChunk *origin, Vector2 pos); //Returns a neighbouring chunk if given position is out of bounds.
 float get_chunk_height_at(WorldChunk *chunk, Vector2 pos); //Returns the y coordinate of WorldChunk's height map at (x, z).
+float get_tile_height(WorldChunk *origin, int x, int z); //Returns the height of a world tile near origin (CHUNK_HEIGHT_CAP outside the world).
+float get_wall_height(const MeshSource *src, int x, int z); //Returns a tile height capped to max_height, x/z of -1 read the west/north border (NAN if missing).
 void join_chunks(WorldChunk *chunk1, Cardinals cardinal, WorldChunk *chunk2); //Set chunks as neighbours and assign world position to chunk2.
+unsigned int chunk_hash(int x, int z); //Hashes a world chunk position.
+int chunk_map_slot(int x, int z); //Returns the map slot holding a chunk position, or the empty slot where it would go.
+WorldChunk *find_chunk(int x, int z); //Returns the loaded chunk at a world chunk position, or NULL.
+void generate_chunk(WorldChunk *chunk, int x, int z); //Points a chunk at its map pack data, or fills it deterministically from its world position and the world seed.
+void link_chunk(WorldChunk *chunk); //Joins a new chunk with its loaded neighbours and flags the seams they share for re-meshing.
+void evict_chunk(WorldChunk *chunk); //Unlinks a chunk from its neighbours, the map and the LRU list and frees its mesh.
+void touch_chunk(WorldChunk *chunk); //Marks a chunk as most recently used.
+bool is_chunk_evictable(WorldChunk *chunk); //Checks a chunk is outside the load radius and not being meshed.
+WorldChunk *load_chunk(int x, int z); //Returns the chunk at a world position, generating it in a free or least recently used slot.
+void stream_chunks(WorldChunk *center); //Loads and touches every chunk within CHUNK_LOAD_RADIUS of center.
+int get_view_radius(); //Returns how many chunks around the followed one the camera can see.
+void refresh_active_chunks(WorldChunk *center); //Recollects the active chunk set if center, view radius or loaded chunks changed.
 void calculate_normals(float *normals, const float *vertices, int c_vertices); //Calculates normals for each triangle.
 Mesh generate_mesh(const float *vertices, int c_vertices); //Generates a custom Mesh (all vertices WHITE).
+void pack_quad(TerrainVertex *vertices, const float *corners, TerrainFace face); //Packs four quad corners into terrain vertices.
+void mesh_push_quad(TerrainMesh *mesh, const float *corners, TerrainFace face, const unsigned short *order); //Append an indexed quad to a mesh being built.
+MeshSource capture_mesh_source(WorldChunk *chunk); //Copies what meshing a chunk reads: its heights, max_height and its west and north neighbours' borders.
+TerrainMesh build_chunk_mesh(const MeshSource *src); //Generates an indexed, greedy-merged chunk mesh without uploading it.
+void build_tile_quads(const MeshSource *src, int x, int z, TerrainVertex *vertices); //Writes a tile's top, west and north quads, collapsed where culled.
+TerrainMesh build_editable_chunk_mesh(const MeshSource *src); //Generates a fixed-layout chunk mesh whose tiles can be re-meshed in place.
+void mark_tile_dirty(WorldChunk *chunk, int x, int z); //Queue a chunk tile for re-meshing.
+void set_tile_height(WorldChunk *chunk, int x, int z, float h); //Edit a tile, dirtying it and the walls it shares with its east and south neighbours.
+void set_terrain_height(WorldChunk *origin, int x, int z, int w, int d, float h); //Edit a rectangle of world tiles lying within one chunk of origin.
+void flush_terrain_edits(); //Re-mesh dirty tiles and upload only the changed vertex ranges.
+void release_terrain_mesh(TerrainMesh *mesh); //Free CPU-side mesh arrays.
+void *mesh_worker(void *arg); //Worker thread loop, meshes pending chunks until the pool stops.
+void mesh_pool_start(); //Starts the chunk meshing workers.
+void mesh_pool_stop(); //Stops the workers and frees meshes that were never taken.
+bool mesh_pool_request(WorldChunk *chunk); //Queue a copy of a chunk to be meshed off the main thread.
+bool mesh_pool_take(MeshJob *job); //Obtain a finished chunk mesh (meshes one in place when there are no workers).
+void upload_terrain_mesh(TerrainMesh *mesh, bool keep_cpu); //Upload a terrain mesh into its own vertex array, optionally releasing CPU arrays.
+void unload_terrain_mesh(TerrainMesh *mesh); //Free GPU and CPU mesh memory.
+void upload_chunk_meshes(int budget); //Upload at most budget finished chunk meshes, replacing the old ones.
+void draw_terrain_mesh(TerrainMesh *mesh, Vector3 pos, Color tint); //DrawModel equivalent for the packed terrain vertex layout.
+NPCHandle create_npc(Vector3 pos); //Adds an inactive NPC with its cold object from the pool, 0 when full.
+void destroy_npc(NPCHandle npc); //Removes an NPC from the store and returns its cold object to the pool.
+int get_npc_index(NPCHandle npc); //Returns an NPC's dense column index, -1 for a destroyed handle.
+NPCObject *get_npc_object(NPCHandle npc); //Returns an NPC's cold object, NULL for a destroyed handle.
+bool is_npc_active(NPCHandle npc); //Checks an NPC sits in the active range.
+bool set_npc_active(NPCHandle npc, bool active); //Moves an NPC between the active and inactive ranges, false when the target range is full.
+void set_npc_velocity(NPCHandle npc, Vector2 v); //Sets an NPC's walking velocity in tiles per second and wakes it.
+void move_npc_column(int from, int to); //Copies an NPC's columns to another dense index and repoints its handle.
+void update_npcs(); //Moves every active NPC by its velocity with gravity and terrain collision, then advances animations.
+void update_npc_range(void *data, int start, int end); //update_npcs job over dense indices [start, end).
+void push_npc_range(void *data, int start, int end); //update_npcs job finding the separation of dense indices [start, end).
+int get_grid_bucket(int x, int z); //Returns the bucket a grid cell is listed in.
+void link_npc_cell(int slot, float x, float z); //Lists an NPC's slot in the grid cell holding (x, z).
+void unlink_npc_cell(int slot); //Takes an NPC's slot out of its grid cell.
+void update_npc_cell(int i); //Moves the NPC at dense index i to another grid cell if it has walked into one.
+int find_npcs_in_circle(Vector2 center, float r, NPCHandle *out, int max); //Collects up to max NPCs overlapping a circle, returns how many.
+int find_nearest_npcs(Vector2 p, int k, float max_dist, NPCHandle *out); //Collects up to k (at most NPC_MAX_NEAREST) NPCs within max_dist of p, nearest first, returns how many.
+int find_npc_pairs(float r, NPCPair *out, int max); //Collects NPCs closer than r to each other, each pair once, returns how many pairs there are even past max.
+int get_npc_chunk_distance(int i); //Returns how many chunks the NPC at dense index i is from the player's, along the farther axis.
+void update_npc_activation(); //Wakes inactive NPCs near the player and puts far active ones to sleep, a budget's worth per update.
+void update_dormant_npcs(); //Walks inactive NPCs a turn's worth of their velocity, ignoring terrain.
+Vector2 get_npc_push(float x, float z, float radius, int self); //Sums half the overlap with every NPC but slot self touching a circle, pointing away from them and at most radius long.
+void begin_frame(); //Resets the frame arena and collects last frame's Allocator counters (direct mallocs aren't seen).
+void setup_world(); //Sets up chunks, objects and camera without touching the GPU.
+void cleanup_world(); //Free world containers.
+void setup_graphics(); //Loads shaders, uploads chunk meshes and loads textures.
 void setup(); //Sets up the game.
 void cleanup(); //Free all remaining objects.
 void process_keyboard(); //Processes keyboard inputs.
@@ -234,31 +585,65 @@ void process_mouse(); //Processes mouse inputs.
 void process_controller(); //Processes controller inputs.
 void process_touch(); //Processes touch inputs.
 void cam_point_update(Vector3 translate, float rotate, float rotate_v, float zoom_factor); //Translates camera target and rotates camera position.
+void sort_pushers(unsigned char *order, const float *keys, int c_pushers); //Stable sort of pusher indices by key, lowest first.
+Vector2 sweep_game_object(GameObject *obj, Vector2 v, float *pos_y); //Sweep object along v through crossed tiles, sliding on walls and stepping up; returns the new xz.
 void move_game_object(GameObject *obj, Vector2 v); //Move game object and update its movement-related properties.
-void draw_background(); //Draws a basic background.
-Rectangle get_game_object_frame(GameObject *obj); //Get the current animation/facing frame of an object.
-void draw_game_object(GameObject *obj);
+void update(); //Steps the world simulation by delta using the current input.
+SimState sim_capture(); //Copies the simulation state that rendering interpolates.
+void sim_apply(FrameState *frame, SimState state); //Writes an interpolated state into a frame's object and camera.
+SimState sim_lerp(SimState from, SimState to, float alpha); //Blends two simulation states.
+void sim_publish(FrameState *frame); //Copies what drawing needs from the simulation into a frame.
+void sim_steps(int c_steps); //Runs fixed steps with replay playback or recording, then publishes the back frame.
+void sim_start(); //Starts the simulation thread when pipelined.
+void sim_stop(); //Waits for and joins the simulation thread.
+void sim_kick(int c_steps); //Hands a batch of steps to the simulation thread.
+void sim_wait(); //Blocks until the simulation thread is idle, after which main owns all simulation state.
+void sim_handoff(); //Swaps frames, pins the new front frame's chunks and does the main-thread chunk work.
+void draw_background(const CamPoint *cam); //Draws a basic background.
+bool is_chunk_visible(const RenderChunk *chunk, Vector3 center, const Vector3 *axes, Vector3 half); //Tests a chunk's height bounds against the camera's view volume.
+void draw_chunks(const FrameState *frame); //Draws the frame's chunks that are inside the camera's view volume.
+Rectangle get_game_object_frame(const GameObject *obj, const CamPoint *cam); //Get the current animation/facing frame of an object.
+void draw_game_object(const GameObject *obj, const CamPoint *cam);
+void replay_apply(const ReplayFrame *frame); //Replaces input and delta with a recorded frame.
+ReplayFrame replay_capture(); //Packs this frame's input and delta with the followed object's resulting position.
+bool replay_check(const ReplayFrame *frame); //Compares the followed object with a played frame bit for bit, counting divergences.
 void update_draw(); //Update and draw.
 
 float delta;
 float screen_scale;
 
+unsigned int rng_state = RNG_SEED;
+unsigned int world_seed = RNG_SEED; //seeds setup_world, taken from a replay when playing one
+
+Replay replay = {0};
+int replay_divergences = 0;
+int replay_first_divergence = -1; //index of the first frame that did not match, -1 when none
+
 RenderTexture2D render_target;
 
 Basic3D basic3d = {0};
+Basic3D terrain3d = {0};
 Basic2D basic2d = {0};
 
 Input input = {0};
 
 CamPoint cam_point = {0};
 
-WorldChunk test_chunks[64] = {0};
+ChunkCache chunk_cache = {0};
+MapPack map_pack = {0};
 
 Vector2 prev_touch_points[MAX_TOUCH_POINTS];
 
 bool light_switch = false;
 
-UQueue active_chunks;
+Arena frame_arena;
+//allocator-tracked only, chunk mesh buffers (built on the workers too) and raylib malloc and free directly
+unsigned long frame_alloc_calls = 0;
+unsigned long frame_alloc_bytes = 0;
+
+ActiveChunks active_chunks = {0};
+ChunkQueue dirty_chunks;
+MeshPool mesh_pool;
 
 ObjectKeeper object_keeper;
 GameObject test_object = {0};
@@ -266,6 +651,22 @@ GameObject test_object = {0};
 float turn_keeper = 0.0f;
 bool next_turn;
 
+float sim_accumulator = 0.0f; //frame time not yet simulated, less than SIM_STEP after the steps
+SimState sim_prev; //state before the last step
+
+bool sim_pipelined = SIM_THREAD; //steps of frame N + 1 run while frame N is drawn, -single turns it off
+SimWorker sim_worker = {0};
+FrameState frame_states[2]; //front is drawn while the simulation publishes into the other
+int front_frame = 0;
+unsigned int frame_epoch = 0; //bumped at each handoff, chunks of the front frame carry it
+
+TerrainMesh retired_meshes[MAX_RETIRED_MESHES]; //evicted by the simulation, unloaded by main at the handoff
+int c_retired_meshes = 0;
+
+int c_considered_chunks = 0;
+int c_drawn_chunks = 0;
+
+#ifndef HEADLESS
 int get_screen_width() {
   if (IsWindowFullscreen()) {
     int monitor = GetCurrentMonitor();
@@ -281,6 +682,7 @@ int get_screen_height() {
   }
   return GetScreenHeight();
 }
+#endif
 
 Color color_d(unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
   float ratio_r = (float)r / 0xff;
@@ -294,11 +696,36 @@ Color color_d(unsigned char r, unsigned char g, unsigned char b, unsigned char a
   };
 }
 
-float *generate_chunk_vertices(WorldChunk *chunk, int *c_vertices) {
+void rng_seed(unsigned int seed) {
+  rng_state = seed ? seed : RNG_SEED;
+}
+
+unsigned int rng_next() {
+  return rng_step(&rng_state);
+}
+
+float rng_float() {
+  return rng_step_float(&rng_state);
+}
+
+unsigned int rng_step(unsigned int *state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+float rng_step_float(unsigned int *state) {
+  return (float)(rng_step(state) >> 8) / (float)(0xffffff);
+}
+
+float *generate_chunk_vertices(WorldChunk *chunk, int *c_vertices, Allocator *a) {
   const int c_square_vertices = 18;
   int c_h_vertices = CHUNK_SIZE_S * c_square_vertices;
   int c_v_vertices = c_h_vertices * 2; // - CHUNK_SIZE * 2 * c_square_vertices;
-  float *vertices = malloc((c_h_vertices + c_v_vertices) * sizeof(float));
+  float *vertices = mem_alloc(a, (c_h_vertices + c_v_vertices) * sizeof(float));
+  if (vertices == NULL)
+    return NULL;
   
   int p = 0;
   for (int i = 0; i < CHUNK_SIZE_S; i++) { //each square
@@ -375,12 +802,16 @@ float *generate_chunk_vertices(WorldChunk *chunk, int *c_vertices) {
 }
 
 WorldChunk *get_chunk_at(WorldChunk *origin, Vector2 pos) {
-  int diff_x = floor(pos.x / CHUNK_SIZE) - origin->w_pos[0];
-  int diff_z = floor(pos.y / CHUNK_SIZE) - origin->w_pos[1];
+  int c_x = floor(pos.x / CHUNK_SIZE);
+  int c_z = floor(pos.y / CHUNK_SIZE);
+  int diff_x = c_x - origin->w_pos[0];
+  int diff_z = c_z - origin->w_pos[1];
+  if (abs(diff_x) > 1 || abs(diff_z) > 1)
+    return find_chunk(c_x, c_z);
   if (diff_z != 0) {
     WorldChunk *neighbour = origin->neighbours[diff_z == 1 ? CARDINAL_SOUTH : CARDINAL_NORTH];
     if (neighbour == NULL)
-      return NULL;
+      return find_chunk(c_x, c_z); //diagonal chunks can be loaded without the one in between
     origin = neighbour;
   }
   if (diff_x != 0) {
@@ -393,15 +824,30 @@ WorldChunk *get_chunk_at(WorldChunk *origin, Vector2 pos) {
 }
 
 float get_chunk_height_at(WorldChunk *chunk, Vector2 pos) {
-  int i_x = (int)pos.x % CHUNK_SIZE;
-  if (i_x < 0)
-    i_x += CHUNK_SIZE;
-  int i_z = (int)pos.y % CHUNK_SIZE;
-  if (i_z < 0)
-    i_z += CHUNK_SIZE;
+  int i_x = (int)floorf(pos.x) - chunk->w_pos[0] * CHUNK_SIZE; //floor like get_chunk_at, a cast cuts negatives toward zero
+  int i_z = (int)floorf(pos.y) - chunk->w_pos[1] * CHUNK_SIZE;
   return chunk->height_map[i_z * CHUNK_SIZE + i_x];
 }
 
+float get_tile_height(WorldChunk *origin, int x, int z) {
+  Vector2 pos = {x + 0.5f, z + 0.5f};
+  WorldChunk *chunk = get_chunk_at(origin, pos);
+  return chunk != NULL ? get_chunk_height_at(chunk, pos) : CHUNK_HEIGHT_CAP;
+}
+
+float get_wall_height(const MeshSource *src, int x, int z) {
+  float h;
+  if (x >= 0 && z >= 0)
+    h = src->height_map[z * CHUNK_SIZE + x];
+  else if (x < 0 && z >= 0)
+    h = src->west[z];
+  else if (z < 0 && x >= 0)
+    h = src->north[x];
+  else
+    h = NAN;
+  return isnan(h) ? h : MIN(h, src->max_height); //no wall towards missing neighbours
+}
+
 void join_chunks(WorldChunk *chunk1, Cardinals cardinal, WorldChunk *chunk2) {
   const int w_x[] = {0, 1, 0, -1};
   const int w_z[] = {-1, 0, 1, 0};
@@ -412,6 +858,232 @@ void join_chunks(WorldChunk *chunk1, Cardinals cardinal, WorldChunk *chunk2) {
   chunk2->w_pos[1] = chunk1->w_pos[1] + w_z[cardinal];
 }
 
+unsigned int chunk_hash(int x, int z) {
+  unsigned int h = (unsigned int)x * 0x9e3779b1u ^ (unsigned int)z * 0x85ebca77u;
+  return h ^ h >> 15;
+}
+
+int chunk_map_slot(int x, int z) {
+  int i = chunk_hash(x, z) & (CHUNK_MAP_SIZE - 1);
+  while (chunk_cache.map[i] != 0) {
+    WorldChunk *chunk = chunk_cache.chunks + chunk_cache.map[i] - 1;
+    if (chunk->w_pos[0] == x && chunk->w_pos[1] == z)
+      break;
+    i = (i + 1) & (CHUNK_MAP_SIZE - 1);
+  }
+  return i;
+}
+
+WorldChunk *find_chunk(int x, int z) {
+  int i = chunk_map_slot(x, z);
+  return chunk_cache.map[i] != 0 ? chunk_cache.chunks + chunk_cache.map[i] - 1 : NULL;
+}
+
+void generate_chunk(WorldChunk *chunk, int x, int z) {
+  //own stream so a chunk is the same whenever it loads and the global one isn't touched by streaming,
+  //keyed by the world seed so a replay regenerates the world it was recorded in
+  unsigned int rng = chunk_hash(x, z) ^ world_seed;
+  if (rng == 0)
+    rng = RNG_SEED;
+  chunk->w_pos[0] = x;
+  chunk->w_pos[1] = z;
+  chunk->mesh_stale = true;
+  const MapPackChunk *packed = map_pack_find(&map_pack, x, z);
+  if (packed != NULL) {
+    chunk->height_map = packed->height_map;
+    chunk->max_height = packed->max_height;
+    chunk->min_height = packed->min_height;
+    chunk->tint = color_d(packed->tint[0], packed->tint[1], packed->tint[2], packed->tint[3]);
+    return;
+  }
+  chunk->height_map = chunk->height_data;
+  chunk->max_height = 5.0f;
+  for (int i = 0; i < CHUNK_SIZE_S; i++)
+    chunk->height_data[i] = rng_step_float(&rng) * 2.0f;
+  chunk->min_height = chunk->height_data[0];
+  for (int i = 1; i < CHUNK_SIZE_S; i++)
+    chunk->min_height = MIN(chunk->min_height, chunk->height_data[i]);
+  unsigned char r = rng_step(&rng) % 256; //in order, argument evaluation order is unspecified
+  unsigned char g = rng_step(&rng) % 256;
+  unsigned char b = rng_step(&rng) % 256;
+  chunk->tint = color_d(r, g, b, 0xff);
+}
+
+void link_chunk(WorldChunk *chunk) {
+  const int w_x[] = {0, 1, 0, -1};
+  const int w_z[] = {-1, 0, 1, 0};
+  for (int i = 0; i < 4; i++) {
+    WorldChunk *neighbour = find_chunk(chunk->w_pos[0] + w_x[i], chunk->w_pos[1] + w_z[i]);
+    if (neighbour != NULL)
+      join_chunks(chunk, i, neighbour);
+  }
+  //the east and south neighbours own the walls facing this chunk
+  WorldChunk *east = chunk->neighbours[CARDINAL_EAST];
+  if (east != NULL && east->mesh.fixed_layout)
+    for (int z = 0; z < CHUNK_SIZE; z++)
+      mark_tile_dirty(east, 0, z);
+  else if (east != NULL)
+    east->mesh_stale = true;
+  WorldChunk *south = chunk->neighbours[CARDINAL_SOUTH];
+  if (south != NULL && south->mesh.fixed_layout)
+    for (int x = 0; x < CHUNK_SIZE; x++)
+      mark_tile_dirty(south, x, 0);
+  else if (south != NULL)
+    south->mesh_stale = true;
+}
+
+void evict_chunk(WorldChunk *chunk) {
+  for (int i = 0; i < 4; i++)
+    if (chunk->neighbours[i] != NULL)
+      chunk->neighbours[i]->neighbours[(i + 2) % 4] = NULL;
+  //backward shift deletion keeps probe chains intact without tombstones
+  int i = chunk_map_slot(chunk->w_pos[0], chunk->w_pos[1]);
+  int j = i;
+  while (true) {
+    j = (j + 1) & (CHUNK_MAP_SIZE - 1);
+    if (chunk_cache.map[j] == 0)
+      break;
+    WorldChunk *c = chunk_cache.chunks + chunk_cache.map[j] - 1;
+    int home = chunk_hash(c->w_pos[0], c->w_pos[1]) & (CHUNK_MAP_SIZE - 1);
+    if (((j - home) & (CHUNK_MAP_SIZE - 1)) >= ((j - i) & (CHUNK_MAP_SIZE - 1))) {
+      chunk_cache.map[i] = chunk_cache.map[j];
+      i = j;
+    }
+  }
+  chunk_cache.map[i] = 0;
+  if (chunk->lru_prev != NULL)
+    chunk->lru_prev->lru_next = chunk->lru_next;
+  else
+    chunk_cache.lru_first = chunk->lru_next;
+  if (chunk->lru_next != NULL)
+    chunk->lru_next->lru_prev = chunk->lru_prev;
+  else
+    chunk_cache.lru_last = chunk->lru_prev;
+  if (chunk_queue_contains(&dirty_chunks, chunk)) { //flush_terrain_edits would re-mesh the zeroed or reused slot
+    WorldChunk *kept[MAX_DIRTY_CHUNKS];
+    int c_kept = 0;
+    WorldChunk *dirty;
+    while (chunk_queue_pop(&dirty_chunks, &dirty))
+      if (dirty != chunk)
+        kept[c_kept++] = dirty;
+    chunk_queue_reset(&dirty_chunks);
+    for (int k = 0; k < c_kept; k++)
+      chunk_queue_push(&dirty_chunks, kept[k]);
+  }
+#ifndef HEADLESS
+  retired_meshes[c_retired_meshes++] = chunk->mesh; //GL calls belong to the main thread
+#else
+  release_terrain_mesh(&chunk->mesh);
+#endif
+  memset(chunk, 0, sizeof(WorldChunk));
+  chunk_cache.generation++;
+}
+
+void touch_chunk(WorldChunk *chunk) {
+  if (chunk_cache.lru_first == chunk)
+    return;
+  if (chunk->lru_prev != NULL)
+    chunk->lru_prev->lru_next = chunk->lru_next;
+  if (chunk->lru_next != NULL)
+    chunk->lru_next->lru_prev = chunk->lru_prev;
+  else if (chunk_cache.lru_last == chunk)
+    chunk_cache.lru_last = chunk->lru_prev;
+  chunk->lru_prev = NULL;
+  chunk->lru_next = chunk_cache.lru_first;
+  if (chunk_cache.lru_first != NULL)
+    chunk_cache.lru_first->lru_prev = chunk;
+  chunk_cache.lru_first = chunk;
+  if (chunk_cache.lru_last == NULL)
+    chunk_cache.lru_last = chunk;
+}
+
+bool is_chunk_evictable(WorldChunk *chunk) {
+  if (abs(chunk->w_pos[0] - chunk_cache.center[0]) <= CHUNK_LOAD_RADIUS && abs(chunk->w_pos[1] - chunk_cache.center[1]) <= CHUNK_LOAD_RADIUS)
+    return false;
+  if (chunk->render_epoch == frame_epoch && frame_epoch != 0) //being drawn
+    return false;
+#ifndef HEADLESS
+  if (c_retired_meshes == MAX_RETIRED_MESHES)
+    return false;
+#endif
+  return !chunk->meshing; //its finished mesh still comes back to this slot
+}
+
+WorldChunk *load_chunk(int x, int z) {
+  int i = chunk_map_slot(x, z);
+  if (chunk_cache.map[i] != 0)
+    return chunk_cache.chunks + chunk_cache.map[i] - 1;
+  WorldChunk *chunk = NULL;
+  if (chunk_cache.c_chunks < MAX_LOADED_CHUNKS)
+    chunk = chunk_cache.chunks + chunk_cache.c_chunks++;
+  else {
+    for (chunk = chunk_cache.lru_last; chunk != NULL && !is_chunk_evictable(chunk); chunk = chunk->lru_prev);
+    if (chunk == NULL)
+      return NULL; //everything is in use, the chunk stays unloaded
+    evict_chunk(chunk);
+    i = chunk_map_slot(x, z); //eviction may shift the probe chain
+  }
+  generate_chunk(chunk, x, z);
+  chunk_cache.generation++;
+  chunk_cache.map[i] = chunk - chunk_cache.chunks + 1;
+  link_chunk(chunk);
+  touch_chunk(chunk);
+  return chunk;
+}
+
+void stream_chunks(WorldChunk *center) {
+  chunk_cache.center[0] = center->w_pos[0];
+  chunk_cache.center[1] = center->w_pos[1];
+  //farthest first so the closest chunks end up most recently used
+  for (int r = CHUNK_LOAD_RADIUS; r >= 0; r--) {
+    for (int z = -r; z <= r; z++) {
+      for (int x = -r; x <= r; x++) {
+        if (abs(x) != r && abs(z) != r)
+          continue;
+        WorldChunk *chunk = load_chunk(center->w_pos[0] + x, center->w_pos[1] + z);
+        if (chunk != NULL)
+          touch_chunk(chunk);
+      }
+    }
+  }
+}
+
+int get_view_radius() {
+  //ground footprint of the view around the target, one chunk of slack for camera lag and tall terrain
+  float half_w = cam_point.cam.fovy * 0.5f * GAME_W / GAME_H;
+  float half_d = cam_point.cam.fovy * 0.5f / sinf(cam_point.rot_v_pi * PI);
+  int radius = ceilf(sqrtf(half_w * half_w + half_d * half_d) / CHUNK_SIZE) + 1;
+  return MIN(radius, CHUNK_LOAD_RADIUS);
+}
+
+void refresh_active_chunks(WorldChunk *center) {
+  int radius = get_view_radius();
+  if (active_chunks.c_chunks > 0 && active_chunks.radius == radius && active_chunks.generation == chunk_cache.generation
+    && active_chunks.center[0] == center->w_pos[0] && active_chunks.center[1] == center->w_pos[1])
+    return;
+  active_chunks.center[0] = center->w_pos[0];
+  active_chunks.center[1] = center->w_pos[1];
+  active_chunks.radius = radius;
+  active_chunks.generation = chunk_cache.generation;
+  active_chunks.epoch++;
+  //BFS with the set itself as the queue, epoch stamps make membership O(1)
+  center->visit_epoch = active_chunks.epoch;
+  active_chunks.chunks[0] = center;
+  active_chunks.c_chunks = 1;
+  for (int i = 0; i < active_chunks.c_chunks; i++) {
+    WorldChunk *chunk = active_chunks.chunks[i];
+    for (int j = 0; j < 4; j++) {
+      WorldChunk *c = chunk->neighbours[j];
+      if (c == NULL || c->visit_epoch == active_chunks.epoch)
+        continue;
+      if (abs(c->w_pos[0] - center->w_pos[0]) > radius || abs(c->w_pos[1] - center->w_pos[1]) > radius)
+        continue;
+      c->visit_epoch = active_chunks.epoch;
+      active_chunks.chunks[active_chunks.c_chunks++] = c;
+    }
+  }
+}
+
 void calculate_normals(float *normals, const float *vertices, int c_vertices) {
   for (int i = 0; i < c_vertices / 9; i++) {
     Vector3 *v = (Vector3 *)vertices + i * 3 + 0;
@@ -424,6 +1096,319 @@ void calculate_normals(float *normals, const float *vertices, int c_vertices) {
   }
 }
 
+void pack_quad(TerrainVertex *vertices, const float *corners, TerrainFace face) {
+  for (int i = 0; i < 4; i++) {
+    vertices[i].x = corners[i * 3 + 0];
+    vertices[i].y = roundf(MAX(-TERRAIN_Y_LIMIT, MIN(corners[i * 3 + 1], TERRAIN_Y_LIMIT)) * TERRAIN_Y_SCALE);
+    vertices[i].z = corners[i * 3 + 2];
+    vertices[i].face = face;
+  }
+}
+
+void mesh_push_quad(TerrainMesh *mesh, const float *corners, TerrainFace face, const unsigned short *order) {
+  int first = mesh->c_vertices;
+  pack_quad(mesh->vertices + first, corners, face);
+  for (int i = 0; i < 6; i++)
+    mesh->indices[mesh->c_indices + i] = first + order[i];
+  mesh->c_vertices += 4;
+  mesh->c_indices += 6;
+}
+
+MeshSource capture_mesh_source(WorldChunk *chunk) {
+  MeshSource src;
+  memcpy(src.height_map, chunk->height_map, sizeof(src.height_map));
+  WorldChunk *west = chunk->neighbours[CARDINAL_WEST];
+  WorldChunk *north = chunk->neighbours[CARDINAL_NORTH];
+  for (int i = 0; i < CHUNK_SIZE; i++) {
+    src.west[i] = west != NULL ? west->height_map[i * CHUNK_SIZE + CHUNK_SIZE - 1] : NAN;
+    src.north[i] = north != NULL ? north->height_map[CHUNK_SIZE_S - CHUNK_SIZE + i] : NAN;
+  }
+  src.max_height = chunk->max_height;
+  src.editable = chunk->editable;
+  return src;
+}
+
+TerrainMesh build_chunk_mesh(const MeshSource *src) {
+  //built in worst-case scratch on the stack (this runs on the mesh workers) and copied out at its final size
+  TerrainVertex vertices[MAX_CHUNK_QUADS * 4];
+  unsigned short indices[MAX_CHUNK_QUADS * 6];
+  TerrainMesh mesh = {0};
+  mesh.vertices = vertices;
+  mesh.indices = indices;
+  
+  //wall heights are capped to max_height, including the west column and north row of the neighbours
+  float walls[(CHUNK_SIZE + 1) * (CHUNK_SIZE + 1)];
+  for (int z = -1; z < CHUNK_SIZE; z++)
+    for (int x = -1; x < CHUNK_SIZE; x++)
+      walls[(z + 1) * (CHUNK_SIZE + 1) + x + 1] = get_wall_height(src, x, z);
+  #define WALL_AT(x, z) walls[((z) + 1) * (CHUNK_SIZE + 1) + (x) + 1]
+  
+  //tops: merge equal-height tiles into rectangles, tiles above max_height sit out of view and are dropped
+  bool done[CHUNK_SIZE_S] = {0};
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+      float h = src->height_map[z * CHUNK_SIZE + x];
+      if (done[z * CHUNK_SIZE + x] || h > src->max_height)
+        continue;
+      int w = 1;
+      while (x + w < CHUNK_SIZE && !done[z * CHUNK_SIZE + x + w] && src->height_map[z * CHUNK_SIZE + x + w] == h)
+        w++;
+      int d = 1;
+      for (bool grow = true; grow && z + d < CHUNK_SIZE; ) {
+        for (int i = 0; i < w && grow; i++)
+          grow = !done[(z + d) * CHUNK_SIZE + x + i] && src->height_map[(z + d) * CHUNK_SIZE + x + i] == h;
+        if (grow)
+          d++;
+      }
+      for (int j = 0; j < d; j++)
+        for (int i = 0; i < w; i++)
+          done[(z + j) * CHUNK_SIZE + x + i] = true;
+      const float corners[] = {
+        x, h, z,
+        x, h, z + d,
+        x + w, h, z,
+        x + w, h, z + d
+      };
+      mesh_push_quad(&mesh, corners, FACE_UP, quad_orders[0]);
+    }
+  }
+  
+  //walls: merge runs along each tile edge that span the same two heights, skipping flat edges
+  for (int x = 0; x < CHUNK_SIZE; x++) {
+    for (int z = 0; z < CHUNK_SIZE; ) {
+      float h = WALL_AT(x, z);
+      float l_y = WALL_AT(x - 1, z);
+      if (isnan(l_y) || l_y == h) {
+        z++;
+        continue;
+      }
+      int d = 1;
+      while (z + d < CHUNK_SIZE && WALL_AT(x, z + d) == h && WALL_AT(x - 1, z + d) == l_y)
+        d++;
+      const float corners[] = {
+        x, l_y, z,
+        x, l_y, z + d,
+        x, h, z + d,
+        x, h, z
+      };
+      mesh_push_quad(&mesh, corners, l_y > h ? FACE_EAST : FACE_WEST, quad_orders[1]);
+      z += d;
+    }
+  }
+  for (int z = 0; z < CHUNK_SIZE; z++) {
+    for (int x = 0; x < CHUNK_SIZE; ) {
+      float h = WALL_AT(x, z);
+      float b_y = WALL_AT(x, z - 1);
+      if (isnan(b_y) || b_y == h) {
+        x++;
+        continue;
+      }
+      int w = 1;
+      while (x + w < CHUNK_SIZE && WALL_AT(x + w, z) == h && WALL_AT(x + w, z - 1) == b_y)
+        w++;
+      const float corners[] = {
+        x + w, b_y, z,
+        x, b_y, z,
+        x, h, z,
+        x + w, h, z
+      };
+      mesh_push_quad(&mesh, corners, b_y > h ? FACE_SOUTH : FACE_NORTH, quad_orders[2]);
+      x += w;
+    }
+  }
+  #undef WALL_AT
+  
+  mesh.vertices = malloc(MAX(mesh.c_vertices, 1) * sizeof(TerrainVertex));
+  mesh.indices  = malloc(MAX(mesh.c_indices, 1) * sizeof(unsigned short));
+  memcpy(mesh.vertices, vertices, mesh.c_vertices * sizeof(TerrainVertex));
+  memcpy(mesh.indices, indices, mesh.c_indices * sizeof(unsigned short));
+  return mesh;
+}
+
+void build_tile_quads(const MeshSource *src, int x, int z, TerrainVertex *vertices) {
+  float top = src->height_map[z * CHUNK_SIZE + x];
+  float h = get_wall_height(src, x, z);
+  float l_y = get_wall_height(src, x - 1, z);
+  float b_y = get_wall_height(src, x, z - 1);
+  memset(vertices, 0, TILE_VERTICES * sizeof(TerrainVertex)); //zero-area quads draw nothing
+  if (top <= src->max_height) {
+    const float corners[] = {
+      x, top, z,
+      x, top, z + 1,
+      x + 1, top, z,
+      x + 1, top, z + 1
+    };
+    pack_quad(vertices, corners, FACE_UP);
+  }
+  if (!isnan(l_y) && l_y != h) {
+    const float corners[] = {
+      x, l_y, z,
+      x, l_y, z + 1,
+      x, h, z + 1,
+      x, h, z
+    };
+    pack_quad(vertices + 4, corners, l_y > h ? FACE_EAST : FACE_WEST);
+  }
+  if (!isnan(b_y) && b_y != h) {
+    const float corners[] = {
+      x + 1, b_y, z,
+      x, b_y, z,
+      x, h, z,
+      x + 1, h, z
+    };
+    pack_quad(vertices + 8, corners, b_y > h ? FACE_SOUTH : FACE_NORTH);
+  }
+}
+
+TerrainMesh build_editable_chunk_mesh(const MeshSource *src) {
+  TerrainMesh mesh = {0};
+  mesh.fixed_layout = true;
+  mesh.c_vertices = CHUNK_SIZE_S * TILE_VERTICES;
+  mesh.c_indices = CHUNK_SIZE_S * 3 * 6;
+  mesh.vertices = malloc(mesh.c_vertices * sizeof(TerrainVertex));
+  mesh.indices = malloc(mesh.c_indices * sizeof(unsigned short));
+  for (int i = 0; i < CHUNK_SIZE_S; i++) {
+    build_tile_quads(src, i % CHUNK_SIZE, i / CHUNK_SIZE, mesh.vertices + i * TILE_VERTICES);
+    for (int q = 0; q < 3; q++)
+      for (int j = 0; j < 6; j++)
+        mesh.indices[(i * 3 + q) * 6 + j] = i * TILE_VERTICES + q * 4 + quad_orders[q][j];
+  }
+  return mesh;
+}
+
+void mark_tile_dirty(WorldChunk *chunk, int x, int z) {
+  chunk->editable = true;
+  chunk->dirty_rows[z] |= 1 << x;
+  chunk_queue_push(&dirty_chunks, chunk);
+}
+
+void set_tile_height(WorldChunk *chunk, int x, int z, float h) {
+  if (chunk->height_map != chunk->height_data) { //the map pack is read-only, copy on first edit
+    memcpy(chunk->height_data, chunk->height_map, CHUNK_SIZE_S * sizeof(float));
+    chunk->height_map = chunk->height_data;
+  }
+  chunk->height_data[z * CHUNK_SIZE + x] = h;
+  chunk->min_height = MIN(chunk->min_height, h);
+  chunk->max_height = MAX(chunk->max_height, h); //a full re-mesh drops tops above it, culling boxes end at it
+  mark_tile_dirty(chunk, x, z);
+  //east and south neighbours own the walls on this tile's far sides
+  if (x + 1 < CHUNK_SIZE)
+    mark_tile_dirty(chunk, x + 1, z);
+  else if (chunk->neighbours[CARDINAL_EAST] != NULL)
+    mark_tile_dirty(chunk->neighbours[CARDINAL_EAST], 0, z);
+  if (z + 1 < CHUNK_SIZE)
+    mark_tile_dirty(chunk, x, z + 1);
+  else if (chunk->neighbours[CARDINAL_SOUTH] != NULL)
+    mark_tile_dirty(chunk->neighbours[CARDINAL_SOUTH], x, 0);
+}
+
+void set_terrain_height(WorldChunk *origin, int x, int z, int w, int d, float h) {
+  for (int j = z; j < z + d; j++) {
+    for (int i = x; i < x + w; i++) {
+      Vector2 pos = {i + 0.5f, j + 0.5f};
+      WorldChunk *chunk = get_chunk_at(origin, pos);
+      if (chunk != NULL)
+        set_tile_height(chunk, i - chunk->w_pos[0] * CHUNK_SIZE, j - chunk->w_pos[1] * CHUNK_SIZE, h);
+    }
+  }
+}
+
+void release_terrain_mesh(TerrainMesh *mesh) {
+  free(mesh->vertices);
+  free(mesh->indices);
+  mesh->vertices = NULL;
+  mesh->indices = NULL;
+}
+
+void *mesh_worker(void *arg) {
+#if MESH_WORKERS > 0
+  PROF_SET_THREAD((intptr_t)arg);
+  pthread_mutex_lock(&mesh_pool.lock);
+  while (true) {
+    MeshRequest request;
+    //only take a request while done has room for it after every mesh still being built, so the push can't fail
+    while (!mesh_pool.quit && (mesh_pool.done.len + mesh_pool.in_flight >= mesh_pool.done.max || !mesh_request_queue_pop(&mesh_pool.pending, &request)))
+      pthread_cond_wait(&mesh_pool.wake, &mesh_pool.lock);
+    if (mesh_pool.quit)
+      break;
+    mesh_pool.in_flight++;
+    pthread_mutex_unlock(&mesh_pool.lock);
+    //only the copy is read, the simulation may be linking or editing the chunk meanwhile
+    MeshJob job = {request.chunk};
+    PROF_ZONE(PROF_MESH_BUILD)
+      job.mesh = request.source.editable ? build_editable_chunk_mesh(&request.source) : build_chunk_mesh(&request.source);
+    pthread_mutex_lock(&mesh_pool.lock);
+    mesh_job_queue_push(&mesh_pool.done, job);
+    mesh_pool.in_flight--;
+  }
+  pthread_mutex_unlock(&mesh_pool.lock);
+#endif
+  return NULL;
+}
+
+void mesh_pool_start() {
+  mesh_pool.pending = mesh_request_queue_create(MAX_MESH_JOBS, UQUEUE_FIFO); //a chunk being meshed isn't requested again
+  mesh_pool.done = mesh_job_queue_create(MAX_MESH_JOBS, UQUEUE_FIFO);
+#if MESH_WORKERS > 0
+  pthread_mutex_init(&mesh_pool.lock, NULL);
+  pthread_cond_init(&mesh_pool.wake, NULL);
+  mesh_pool.in_flight = 0;
+  mesh_pool.quit = false;
+  for (int i = 0; i < MESH_WORKERS; i++)
+    pthread_create(mesh_pool.threads + i, NULL, mesh_worker, (void *)(intptr_t)(i + 1)); //thread index for the profiler
+#endif
+}
+
+void mesh_pool_stop() {
+#if MESH_WORKERS > 0
+  pthread_mutex_lock(&mesh_pool.lock);
+  mesh_pool.quit = true;
+  pthread_cond_broadcast(&mesh_pool.wake);
+  pthread_mutex_unlock(&mesh_pool.lock);
+  for (int i = 0; i < MESH_WORKERS; i++)
+    pthread_join(mesh_pool.threads[i], NULL);
+  pthread_mutex_destroy(&mesh_pool.lock);
+  pthread_cond_destroy(&mesh_pool.wake);
+#endif
+  MeshJob job;
+  while (mesh_job_queue_pop(&mesh_pool.done, &job))
+    release_terrain_mesh(&job.mesh);
+  mesh_request_queue_destroy(&mesh_pool.pending);
+  mesh_job_queue_destroy(&mesh_pool.done);
+}
+
+bool mesh_pool_request(WorldChunk *chunk) {
+  MeshRequest request = {chunk, capture_mesh_source(chunk)};
+#if MESH_WORKERS > 0
+  pthread_mutex_lock(&mesh_pool.lock);
+  bool queued = mesh_request_queue_push(&mesh_pool.pending, request);
+  pthread_cond_signal(&mesh_pool.wake);
+  pthread_mutex_unlock(&mesh_pool.lock);
+  return queued;
+#else
+  return mesh_request_queue_push(&mesh_pool.pending, request);
+#endif
+}
+
+bool mesh_pool_take(MeshJob *job) {
+#if MESH_WORKERS > 0
+  pthread_mutex_lock(&mesh_pool.lock);
+  bool taken = mesh_job_queue_pop(&mesh_pool.done, job);
+  if (taken)
+    pthread_cond_signal(&mesh_pool.wake); //a worker may be waiting for room
+  pthread_mutex_unlock(&mesh_pool.lock);
+  return taken;
+#else
+  MeshRequest request;
+  if (!mesh_request_queue_pop(&mesh_pool.pending, &request))
+    return false;
+  job->chunk = request.chunk;
+  job->mesh = request.source.editable ? build_editable_chunk_mesh(&request.source) : build_chunk_mesh(&request.source);
+  return true;
+#endif
+}
+
+#ifndef HEADLESS
 Mesh generate_mesh(const float *vertices, int c_vertices) {
   Mesh mesh = {0};
   mesh.vertexCount = c_vertices / 3;
@@ -444,21 +1429,458 @@ Mesh generate_mesh(const float *vertices, int c_vertices) {
   return mesh;
 }
 
-void setup() {
-  basic3d.shader = LoadShader(TextFormat("./res/shaders/%i_basic3d.vs", GLSL_VERSION), TextFormat("./res/shaders/%i_basic3d.fs", GLSL_VERSION));
-  basic3d.light_src_loc = GetShaderLocation(basic3d.shader, "light_src");
-  basic3d.color_depth_loc = GetShaderLocation(basic3d.shader, "color_depth");
-  basic3d.light_intensity_loc = GetShaderLocation(basic3d.shader, "light_intensity");
-  basic3d.with_texture_loc = GetShaderLocation(basic3d.shader, "with_texture");
-  
-  SetShaderValue(basic3d.shader, basic3d.color_depth_loc, (float[3]){COLOR_DEPTH_R, COLOR_DEPTH_G, COLOR_DEPTH_B}, SHADER_UNIFORM_VEC3);
-  SetShaderValue(basic3d.shader, basic3d.light_intensity_loc, (float[1]){12000.0f}, SHADER_UNIFORM_FLOAT);
-  
-  basic2d.shader = LoadShader(0, TextFormat("./res/shaders/%i_basic2d.fs", GLSL_VERSION));
-  basic2d.color_depth_loc = GetShaderLocation(basic2d.shader, "color_depth");
-  
-  SetShaderValue(basic2d.shader, basic2d.color_depth_loc, (float[3]){COLOR_DEPTH_R, COLOR_DEPTH_G, COLOR_DEPTH_B}, SHADER_UNIFORM_VEC3);
+void upload_terrain_mesh(TerrainMesh *mesh, bool keep_cpu) {
+  int loc = terrain3d.shader.locs[SHADER_LOC_VERTEX_POSITION];
+  mesh->vao = rlLoadVertexArray();
+  rlEnableVertexArray(mesh->vao);
+  mesh->vbo = rlLoadVertexBuffer(mesh->vertices, mesh->c_vertices * sizeof(TerrainVertex), mesh->fixed_layout);
+  rlSetVertexAttribute(loc, 4, RL_SHORT, false, sizeof(TerrainVertex), 0);
+  rlEnableVertexAttribute(loc);
+  mesh->ebo = rlLoadVertexBufferElement(mesh->indices, mesh->c_indices * sizeof(unsigned short), false);
+  rlDisableVertexArray();
+  if (!keep_cpu)
+    release_terrain_mesh(mesh);
+}
+
+void unload_terrain_mesh(TerrainMesh *mesh) {
+  rlUnloadVertexArray(mesh->vao);
+  rlUnloadVertexBuffer(mesh->vbo);
+  rlUnloadVertexBuffer(mesh->ebo);
+  release_terrain_mesh(mesh);
+}
+
+void flush_terrain_edits() {
+  WorldChunk *chunk;
+  while (chunk_queue_pop(&dirty_chunks, &chunk)) {
+    TerrainMesh *mesh = &chunk->mesh;
+    MeshSource source = capture_mesh_source(chunk);
+    if (!mesh->fixed_layout) { //first edit swaps the greedy mesh for the fixed layout
+      unload_terrain_mesh(mesh);
+      *mesh = build_editable_chunk_mesh(&source);
+      upload_terrain_mesh(mesh, true);
+      memset(chunk->dirty_rows, 0, sizeof(chunk->dirty_rows));
+      continue;
+    }
+    int run = -1;
+    for (int i = 0; i <= CHUNK_SIZE_S; i++) {
+      bool dirty = i < CHUNK_SIZE_S && (chunk->dirty_rows[i / CHUNK_SIZE] >> (i % CHUNK_SIZE) & 1);
+      if (dirty) {
+        build_tile_quads(&source, i % CHUNK_SIZE, i / CHUNK_SIZE, mesh->vertices + i * TILE_VERTICES);
+        if (run < 0)
+          run = i;
+      }
+      else if (run >= 0) { //upload each contiguous run of dirty tiles
+        int offset = run * TILE_VERTICES;
+        rlUpdateVertexBuffer(mesh->vbo, mesh->vertices + offset, (i - run) * TILE_VERTICES * sizeof(TerrainVertex), offset * sizeof(TerrainVertex));
+        run = -1;
+      }
+    }
+    memset(chunk->dirty_rows, 0, sizeof(chunk->dirty_rows));
+  }
+  chunk_queue_reset(&dirty_chunks);
+}
+
+void upload_chunk_meshes(int budget) {
+  MeshJob job;
+  for (int i = 0; i < budget && mesh_pool_take(&job); i++) {
+    WorldChunk *chunk = job.chunk;
+    chunk->meshing = false;
+    if (chunk->mesh.fixed_layout) { //edited since the request, flush_terrain_edits owns this mesh now
+      release_terrain_mesh(&job.mesh);
+      continue;
+    }
+    unload_terrain_mesh(&chunk->mesh);
+    chunk->mesh = job.mesh;
+    upload_terrain_mesh(&chunk->mesh, chunk->editable);
+  }
+}
+
+void draw_terrain_mesh(TerrainMesh *mesh, Vector3 pos, Color tint) {
+  if (mesh->c_indices == 0) //not uploaded yet
+    return;
+  Shader shader = terrain3d.shader;
+  rlEnableShader(shader.id);
+  float diffuse[4] = {tint.r / 255.0f, tint.g / 255.0f, tint.b / 255.0f, tint.a / 255.0f};
+  rlSetUniform(shader.locs[SHADER_LOC_COLOR_DIFFUSE], diffuse, SHADER_UNIFORM_VEC4, 1);
+  Matrix mat_view = rlGetMatrixModelview();
+  Matrix mat_model = MatrixMultiply(MatrixTranslate(pos.x, pos.y, pos.z), rlGetMatrixTransform());
+  rlSetUniformMatrix(shader.locs[SHADER_LOC_MATRIX_VIEW], mat_view);
+  rlSetUniformMatrix(shader.locs[SHADER_LOC_MATRIX_MODEL], mat_model);
+  rlSetUniformMatrix(shader.locs[SHADER_LOC_MATRIX_MVP], MatrixMultiply(MatrixMultiply(mat_model, mat_view), rlGetMatrixProjection()));
+  if (!rlEnableVertexArray(mesh->vao)) {
+    int loc = shader.locs[SHADER_LOC_VERTEX_POSITION];
+    rlEnableVertexBuffer(mesh->vbo);
+    rlSetVertexAttribute(loc, 4, RL_SHORT, false, sizeof(TerrainVertex), 0);
+    rlEnableVertexAttribute(loc);
+    rlEnableVertexBufferElement(mesh->ebo);
+  }
+  rlDrawVertexArrayElements(0, mesh->c_indices, 0);
+  rlDisableVertexArray();
+  rlDisableVertexBuffer();
+  rlDisableVertexBufferElement();
+  rlDisableShader();
+}
+
+#endif
+
+NPCHandle create_npc(Vector3 pos) {
+  NPCStore *s = &object_keeper.npcs;
+  if (s->c_free_slots == 0 || s->c_inactive == MAX_INACTIVE_NPCS)
+    return 0;
+  NPCObject *npc = mem_alloc(&object_keeper.npc_pool.base, sizeof(NPCObject));
+  if (npc == NULL)
+    return 0;
+  memset(npc, 0, sizeof(NPCObject));
+  npc->combat_obj.game_obj.radius = 0.25f;
+  int slot = s->free_slots[--s->c_free_slots];
+  int i = MAX_ACTIVE_NPCS + s->c_inactive++;
+  s->pos_x[i] = pos.x;
+  s->pos_y[i] = pos.y;
+  s->pos_z[i] = pos.z;
+  s->vel_x[i] = 0.0f;
+  s->vel_z[i] = 0.0f;
+  s->dir_x[i] = 0.0f;
+  s->dir_z[i] = 1.0f;
+  s->radius[i] = npc->combat_obj.game_obj.radius;
+  s->g_speed[i] = 0.0f;
+  s->flags[i] = 0;
+  s->animation_index[i] = 0;
+  s->frame_index[i] = 0.0f;
+  s->stats[i] = (NPCStats){0};
+  s->cold[i] = npc;
+  s->handle[i] = s->generation[slot] << NPC_SLOT_BITS | slot;
+  s->dense[slot] = i;
+  link_npc_cell(slot, pos.x, pos.z);
+  return s->handle[i];
+}
+
+void destroy_npc(NPCHandle npc) {
+  NPCStore *s = &object_keeper.npcs;
+  int i = get_npc_index(npc);
+  if (i < 0)
+    return;
+  mem_release(&object_keeper.npc_pool.base, s->cold[i]);
+  int slot = npc & ((1u << NPC_SLOT_BITS) - 1);
+  unlink_npc_cell(slot);
+  s->generation[slot]++;
+  s->free_slots[s->c_free_slots++] = slot;
+  //swap the range's last NPC into the hole
+  if (i < MAX_ACTIVE_NPCS)
+    move_npc_column(--s->c_active, i);
+  else
+    move_npc_column(MAX_ACTIVE_NPCS + --s->c_inactive, i);
+}
+
+int get_npc_index(NPCHandle npc) {
+  NPCStore *s = &object_keeper.npcs;
+  unsigned int slot = npc & ((1u << NPC_SLOT_BITS) - 1);
+  if (slot >= MAX_NPCS || (s->generation[slot] << NPC_SLOT_BITS | slot) != npc)
+    return -1;
+  return s->dense[slot];
+}
+
+NPCObject *get_npc_object(NPCHandle npc) {
+  int i = get_npc_index(npc);
+  return i < 0 ? NULL : object_keeper.npcs.cold[i];
+}
+
+bool is_npc_active(NPCHandle npc) {
+  int i = get_npc_index(npc);
+  return i >= 0 && i < MAX_ACTIVE_NPCS;
+}
+
+bool set_npc_active(NPCHandle npc, bool active) {
+  NPCStore *s = &object_keeper.npcs;
+  int i = get_npc_index(npc);
+  if (i < 0)
+    return false;
+  if ((i < MAX_ACTIVE_NPCS) == active)
+    return true;
+  if (active) {
+    if (s->c_active == MAX_ACTIVE_NPCS)
+      return false;
+    move_npc_column(i, s->c_active++);
+    move_npc_column(MAX_ACTIVE_NPCS + --s->c_inactive, i);
+  }
+  else {
+    if (s->c_inactive == MAX_INACTIVE_NPCS)
+      return false;
+    move_npc_column(i, MAX_ACTIVE_NPCS + s->c_inactive++);
+    move_npc_column(--s->c_active, i);
+  }
+  return true;
+}
+
+void set_npc_velocity(NPCHandle npc, Vector2 v) {
+  NPCStore *s = &object_keeper.npcs;
+  int i = get_npc_index(npc);
+  if (i < 0)
+    return;
+  s->vel_x[i] = v.x;
+  s->vel_z[i] = v.y;
+  s->flags[i] &= ~NPC_SETTLED;
+}
+
+void move_npc_column(int from, int to) {
+  NPCStore *s = &object_keeper.npcs;
+  if (from == to)
+    return;
+  s->pos_x[to] = s->pos_x[from];
+  s->pos_y[to] = s->pos_y[from];
+  s->pos_z[to] = s->pos_z[from];
+  s->vel_x[to] = s->vel_x[from];
+  s->vel_z[to] = s->vel_z[from];
+  s->dir_x[to] = s->dir_x[from];
+  s->dir_z[to] = s->dir_z[from];
+  s->radius[to] = s->radius[from];
+  s->g_speed[to] = s->g_speed[from];
+  s->flags[to] = s->flags[from];
+  s->animation_index[to] = s->animation_index[from];
+  s->frame_index[to] = s->frame_index[from];
+  s->stats[to] = s->stats[from];
+  s->cold[to] = s->cold[from];
+  s->handle[to] = s->handle[from];
+  s->dense[s->handle[to] & ((1u << NPC_SLOT_BITS) - 1)] = to;
+}
+
+int get_grid_bucket(int x, int z) {
+  return chunk_hash(x, z) & (NPC_GRID_BUCKETS - 1);
+}
+
+void link_npc_cell(int slot, float x, float z) {
+  NPCGrid *g = &object_keeper.npc_grid;
+  g->cell_x[slot] = floorf(x / NPC_GRID_CELL);
+  g->cell_z[slot] = floorf(z / NPC_GRID_CELL);
+  unsigned short *head = g->head + get_grid_bucket(g->cell_x[slot], g->cell_z[slot]);
+  g->prev[slot] = 0;
+  g->next[slot] = *head;
+  if (*head != 0)
+    g->prev[*head - 1] = slot + 1;
+  *head = slot + 1;
+}
+
+void unlink_npc_cell(int slot) {
+  NPCGrid *g = &object_keeper.npc_grid;
+  if (g->prev[slot] != 0)
+    g->next[g->prev[slot] - 1] = g->next[slot];
+  else
+    g->head[get_grid_bucket(g->cell_x[slot], g->cell_z[slot])] = g->next[slot];
+  if (g->next[slot] != 0)
+    g->prev[g->next[slot] - 1] = g->prev[slot];
+}
+
+void update_npc_cell(int i) {
+  NPCStore *s = &object_keeper.npcs;
+  NPCGrid *g = &object_keeper.npc_grid;
+  int slot = s->handle[i] & ((1u << NPC_SLOT_BITS) - 1);
+  if (g->cell_x[slot] == (int)floorf(s->pos_x[i] / NPC_GRID_CELL) && g->cell_z[slot] == (int)floorf(s->pos_z[i] / NPC_GRID_CELL))
+    return;
+  unlink_npc_cell(slot);
+  link_npc_cell(slot, s->pos_x[i], s->pos_z[i]);
+}
+
+int find_npcs_in_circle(Vector2 center, float r, NPCHandle *out, int max) {
+  NPCStore *s = &object_keeper.npcs;
+  NPCGrid *g = &object_keeper.npc_grid;
+  float reach = r + NPC_MAX_RADIUS;
+  int c_found = 0;
+  for (int z = floorf((center.y - reach) / NPC_GRID_CELL); z <= (int)floorf((center.y + reach) / NPC_GRID_CELL); z++) {
+    for (int x = floorf((center.x - reach) / NPC_GRID_CELL); x <= (int)floorf((center.x + reach) / NPC_GRID_CELL); x++) {
+      for (int n = g->head[get_grid_bucket(x, z)]; n != 0; n = g->next[n - 1]) {
+        if (g->cell_x[n - 1] != x || g->cell_z[n - 1] != z)
+          continue;
+        int i = s->dense[n - 1];
+        float dx = s->pos_x[i] - center.x;
+        float dz = s->pos_z[i] - center.y;
+        float d = r + s->radius[i];
+        if (dx * dx + dz * dz < d * d && c_found < max)
+          out[c_found++] = s->handle[i];
+      }
+    }
+  }
+  return c_found;
+}
+
+int find_nearest_npcs(Vector2 p, int k, float max_dist, NPCHandle *out) {
+  NPCStore *s = &object_keeper.npcs;
+  NPCGrid *g = &object_keeper.npc_grid;
+  float dist_sqr[NPC_MAX_NEAREST];
+  k = MIN(k, NPC_MAX_NEAREST);
+  int c_found = 0;
+  int cx = floorf(p.x / NPC_GRID_CELL);
+  int cz = floorf(p.y / NPC_GRID_CELL);
+  int max_ring = max_dist / NPC_GRID_CELL + 1.0f;
+  for (int ring = 0; ring <= max_ring; ring++) {
+    //once rings up to ring - 1 are searched every NPC closer than (ring - 1) cells has been seen
+    float seen = (ring - 1) * NPC_GRID_CELL;
+    if (c_found == k && ring > 0 && dist_sqr[k - 1] < seen * seen)
+      break;
+    for (int z = cz - ring; z <= cz + ring; z++) {
+      //only the ring's border, its inside was searched by the smaller rings
+      int step = z == cz - ring || z == cz + ring ? 1 : 2 * ring;
+      for (int x = cx - ring; x <= cx + ring; x += step) {
+        for (int n = g->head[get_grid_bucket(x, z)]; n != 0; n = g->next[n - 1]) {
+          if (g->cell_x[n - 1] != x || g->cell_z[n - 1] != z)
+            continue;
+          int i = s->dense[n - 1];
+          float dx = s->pos_x[i] - p.x;
+          float dz = s->pos_z[i] - p.y;
+          float d = dx * dx + dz * dz;
+          if (d > max_dist * max_dist || (c_found == k && d >= dist_sqr[k - 1]))
+            continue;
+          int j = c_found < k ? c_found++ : k - 1;
+          for (; j > 0 && dist_sqr[j - 1] > d; j--) {
+            dist_sqr[j] = dist_sqr[j - 1];
+            out[j] = out[j - 1];
+          }
+          dist_sqr[j] = d;
+          out[j] = s->handle[i];
+        }
+      }
+    }
+  }
+  return c_found;
+}
+
+int find_npc_pairs(float r, NPCPair *out, int max) {
+  NPCStore *s = &object_keeper.npcs;
+  NPCGrid *g = &object_keeper.npc_grid;
+  int cells = ceilf(r / NPC_GRID_CELL);
+  int c_pairs = 0;
+  for (int i = 0; i < MAX_NPCS; i++) {
+    //skip the gap between the active and inactive ranges
+    if (i == s->c_active)
+      i = MAX_ACTIVE_NPCS;
+    if (i == MAX_ACTIVE_NPCS + s->c_inactive)
+      break;
+    int slot = s->handle[i] & ((1u << NPC_SLOT_BITS) - 1);
+    for (int z = g->cell_z[slot] - cells; z <= g->cell_z[slot] + cells; z++) {
+      for (int x = g->cell_x[slot] - cells; x <= g->cell_x[slot] + cells; x++) {
+        for (int n = g->head[get_grid_bucket(x, z)]; n != 0; n = g->next[n - 1]) {
+          //each pair is found from both ends, keep the one from the lower slot
+          if (n - 1 <= slot || g->cell_x[n - 1] != x || g->cell_z[n - 1] != z)
+            continue;
+          int j = s->dense[n - 1];
+          float dx = s->pos_x[j] - s->pos_x[i];
+          float dz = s->pos_z[j] - s->pos_z[i];
+          if (dx * dx + dz * dz >= r * r)
+            continue;
+          if (c_pairs < max)
+            out[c_pairs] = (NPCPair){s->handle[i], s->handle[j]};
+          c_pairs++;
+        }
+      }
+    }
+  }
+  return c_pairs;
+}
+
+int get_npc_chunk_distance(int i) {
+  NPCStore *s = &object_keeper.npcs;
+  WorldChunk *center = test_object.current_chunk;
+  int dx = abs((int)floorf(s->pos_x[i] / CHUNK_SIZE) - center->w_pos[0]);
+  int dz = abs((int)floorf(s->pos_z[i] / CHUNK_SIZE) - center->w_pos[1]);
+  return MAX(dx, dz);
+}
+
+void update_npc_activation() {
+  NPCStore *s = &object_keeper.npcs;
+  int budget = NPC_ACTIVATION_BUDGET;
+  //sleep first so the woken have room; a moved NPC leaves another in its index, which is checked next
+  for (int c = 0; c < NPC_ACTIVATION_SCAN && budget > 0 && s->c_active > 0; c++) {
+    if (s->sleep_cursor >= s->c_active)
+      s->sleep_cursor = 0;
+    int i = s->sleep_cursor;
+    if (get_npc_chunk_distance(i) > NPC_DEACTIVATE_RADIUS && set_npc_active(s->handle[i], false))
+      budget--;
+    else
+      s->sleep_cursor++;
+  }
+  for (int c = 0; c < NPC_ACTIVATION_SCAN && budget > 0 && s->c_inactive > 0 && s->c_active < MAX_ACTIVE_NPCS; c++) {
+    if (s->wake_cursor >= s->c_inactive)
+      s->wake_cursor = 0;
+    int i = MAX_ACTIVE_NPCS + s->wake_cursor;
+    WorldChunk *chunk = NULL;
+    if (get_npc_chunk_distance(i) <= NPC_ACTIVATE_RADIUS)
+      chunk = find_chunk(floorf(s->pos_x[i] / CHUNK_SIZE), floorf(s->pos_z[i] / CHUNK_SIZE));
+    if (chunk == NULL) {
+      s->wake_cursor++;
+      continue;
+    }
+    if (s->flags[i] & NPC_DORMANT_MOVED) {
+      s->pos_y[i] = get_chunk_height_at(chunk, (Vector2){s->pos_x[i], s->pos_z[i]});
+      s->g_speed[i] = 0.0f;
+      s->flags[i] &= ~(NPC_DORMANT_MOVED | NPC_SETTLED);
+    }
+    set_npc_active(s->handle[i], true);
+    budget--;
+  }
+}
+
+void update_dormant_npcs() {
+  NPCStore *s = &object_keeper.npcs;
+  for (int i = MAX_ACTIVE_NPCS; i < MAX_ACTIVE_NPCS + s->c_inactive; i++) {
+    if (s->vel_x[i] == 0.0f && s->vel_z[i] == 0.0f)
+      continue;
+    s->pos_x[i] += s->vel_x[i] / TPS;
+    s->pos_z[i] += s->vel_z[i] / TPS;
+    s->flags[i] |= NPC_DORMANT_MOVED;
+    update_npc_cell(i);
+  }
+}
+
+Vector2 get_npc_push(float x, float z, float radius, int self) {
+  NPCStore *s = &object_keeper.npcs;
+  NPCGrid *g = &object_keeper.npc_grid;
+  float reach = radius + NPC_MAX_RADIUS;
+  Vector2 push = {0.0f, 0.0f};
+  for (int cz = floorf((z - reach) / NPC_GRID_CELL); cz <= (int)floorf((z + reach) / NPC_GRID_CELL); cz++) {
+    for (int cx = floorf((x - reach) / NPC_GRID_CELL); cx <= (int)floorf((x + reach) / NPC_GRID_CELL); cx++) {
+      for (int n = g->head[get_grid_bucket(cx, cz)]; n != 0; n = g->next[n - 1]) {
+        if (n - 1 == self || g->cell_x[n - 1] != cx || g->cell_z[n - 1] != cz)
+          continue;
+        int i = s->dense[n - 1];
+        float dx = x - s->pos_x[i];
+        float dz = z - s->pos_z[i];
+        float d = sqrtf(dx * dx + dz * dz);
+        float overlap = radius + s->radius[i] - d;
+        if (overlap <= 0.0f)
+          continue;
+        if (d > 0.0f) {
+          push.x += dx / d * overlap * 0.5f;
+          push.y += dz / d * overlap * 0.5f;
+        }
+        else //on top of each other, the lower slot steps west so the two always split
+          push.x += (self < n - 1 ? -overlap : overlap) * 0.5f;
+      }
+    }
+  }
+  float l = Vector2Length(push);
+  return l > radius ? Vector2Scale(push, radius / l) : push;
+}
+
+void begin_frame() {
+  Allocator *allocators[] = {&heap_allocator, &frame_arena.base, &object_keeper.npc_pool.base};
+  frame_alloc_calls = 0;
+  frame_alloc_bytes = 0;
+  for (int i = 0; i < sizeof(allocators) / sizeof(Allocator *); i++) {
+    frame_alloc_calls += allocators[i]->calls;
+    frame_alloc_bytes += allocators[i]->bytes;
+    allocator_reset_stats(allocators[i]);
+  }
+  arena_reset(&frame_arena);
+}
+
+void setup_world() {
+  rng_seed(world_seed);
+  frame_arena = arena_create(FRAME_ARENA_SIZE);
+  memset(&chunk_cache, 0, sizeof(chunk_cache));
+  if (!map_pack_open(&map_pack, MAP_PACK_PATH) || map_pack.chunk_size != CHUNK_SIZE) {
+    fprintf(stderr, "could not load %s, generating every chunk\n", MAP_PACK_PATH);
+    map_pack_close(&map_pack);
+  }
   
+  cam_point = (CamPoint){0};
   cam_point.zoom = TILE_SIZE;
   cam_point.cam.position   = Vector3Zero();
   cam_point.cam.target     = Vector3Zero();
@@ -469,40 +1891,25 @@ void setup() {
   cam_point.rot_v_pi = 1.0f / 6;
   cam_point.rot_pi = 0.25f;
   
-  for (int i = 0; i < 64; i++) {
-    WorldChunk *chunk = test_chunks + i;
-    chunk->max_height = 5.0f;
-    for (int j = 0; j < CHUNK_SIZE_S; j++)
-      chunk->height_map[j] = rand() * 2.0f / (float)RAND_MAX;
-    int x = i % 8;
-    int y = i / 8;
-    if (y > 0)
-      join_chunks(chunk, CARDINAL_NORTH, test_chunks + i - 8);
-    if (x < 7)
-      join_chunks(chunk, CARDINAL_EAST, test_chunks + i + 1);
-    if (y < 7)
-      join_chunks(chunk, CARDINAL_SOUTH, test_chunks + i + 8);
-    if (x > 0)
-      join_chunks(chunk, CARDINAL_WEST, test_chunks + i - 1);
-  }
-  memcpy(test_chunks, &test_0_0_height_map, CHUNK_SIZE_S * sizeof(float));
-  for (int i = 0; i < 64; i++) {
-    WorldChunk *chunk = test_chunks + i;
-    int c_test_vertices;
-    float *test_vertices;
-    test_vertices = generate_chunk_vertices(chunk, &c_test_vertices);
-    chunk->mesh = generate_mesh(test_vertices, c_test_vertices);
-    chunk->model = LoadModelFromMesh(chunk->mesh);
-    chunk->model.materials[0].shader = basic3d.shader;
-    free(test_vertices);
-    chunk->tint = color_d(rand() % 256, rand() % 256, rand() % 256, 0xff);
-  }
-  active_chunks = uqueue_create(MAX_ACTIVE_CHUNKS, sizeof(WorldChunk *));
-  
-  object_keeper.active_npcs = uqueue_create(MAX_ACTIVE_NPCS, sizeof(NPCObject *));
-  object_keeper.inactive_npcs = uqueue_create(MAX_INACTIVE_NPCS, sizeof(NPCObject *));
-  
-  test_object.current_chunk = test_chunks;
+  active_chunks = (ActiveChunks){0};
+  dirty_chunks = chunk_queue_create(MAX_DIRTY_CHUNKS, UQUEUE_UNIQUE);
+  
+  object_keeper.npc_pool = pool_create(sizeof(NPCObject), MAX_ACTIVE_NPCS + MAX_INACTIVE_NPCS);
+  NPCStore *npcs = &object_keeper.npcs;
+  npcs->c_active = 0;
+  npcs->c_inactive = 0;
+  npcs->c_free_slots = MAX_NPCS;
+  npcs->wake_cursor = 0;
+  npcs->sleep_cursor = 0;
+  memset(object_keeper.npc_grid.head, 0, sizeof(object_keeper.npc_grid.head));
+  for (int i = 0; i < MAX_NPCS; i++) {
+    npcs->free_slots[i] = MAX_NPCS - 1 - i; //lowest slots first
+    npcs->generation[i]++; //handles from an earlier world stay dead, and 0 is never issued
+  }
+  
+  test_object = (GameObject){0};
+  test_object.current_chunk = load_chunk(0, 0);
+  stream_chunks(test_object.current_chunk);
   test_object.pos = (Vector3){7.5f, 16.0f, 7.5f};
   test_object.radius = 0.25f;
   test_object.sprite_size[0] = 16;
@@ -517,6 +1924,50 @@ void setup() {
   test_object.facings[6] = (Vector3){-1.0f, 0.0f, 0.0f};
   test_object.facings[7] = Vector3Normalize((Vector3){-1.0f, 0.0f, 1.0f});
   test_object.c_animations = 2;
+  test_object.tint = (Color){0xff, 0xff, 0xff, 0xff};
+  
+  cam_point.follow_obj = &test_object;
+  turn_keeper = 0.0f;
+  next_turn = false;
+  sim_accumulator = 0.0f;
+  sim_prev = sim_capture();
+}
+
+void cleanup_world() {
+  map_pack_close(&map_pack);
+  chunk_queue_destroy(&dirty_chunks);
+  pool_destroy(&object_keeper.npc_pool);
+  arena_destroy(&frame_arena);
+}
+
+#ifndef HEADLESS
+void setup_graphics() {
+  basic3d.shader = LoadShader(TextFormat("./res/shaders/%i_basic3d.vs", GLSL_VERSION), TextFormat("./res/shaders/%i_basic3d.fs", GLSL_VERSION));
+  basic3d.light_src_loc = GetShaderLocation(basic3d.shader, "light_src");
+  basic3d.color_depth_loc = GetShaderLocation(basic3d.shader, "color_depth");
+  basic3d.light_intensity_loc = GetShaderLocation(basic3d.shader, "light_intensity");
+  basic3d.with_texture_loc = GetShaderLocation(basic3d.shader, "with_texture");
+  
+  SetShaderValue(basic3d.shader, basic3d.color_depth_loc, (float[3]){COLOR_DEPTH_R, COLOR_DEPTH_G, COLOR_DEPTH_B}, SHADER_UNIFORM_VEC3);
+  SetShaderValue(basic3d.shader, basic3d.light_intensity_loc, (float[1]){12000.0f}, SHADER_UNIFORM_FLOAT);
+  
+  terrain3d.shader = LoadShader(TextFormat("./res/shaders/%i_terrain.vs", GLSL_VERSION), TextFormat("./res/shaders/%i_basic3d.fs", GLSL_VERSION));
+  terrain3d.light_src_loc = GetShaderLocation(terrain3d.shader, "light_src");
+  terrain3d.color_depth_loc = GetShaderLocation(terrain3d.shader, "color_depth");
+  terrain3d.light_intensity_loc = GetShaderLocation(terrain3d.shader, "light_intensity");
+  terrain3d.with_texture_loc = GetShaderLocation(terrain3d.shader, "with_texture");
+  
+  SetShaderValue(terrain3d.shader, terrain3d.color_depth_loc, (float[3]){COLOR_DEPTH_R, COLOR_DEPTH_G, COLOR_DEPTH_B}, SHADER_UNIFORM_VEC3);
+  SetShaderValue(terrain3d.shader, terrain3d.light_intensity_loc, (float[1]){12000.0f}, SHADER_UNIFORM_FLOAT);
+  SetShaderValue(terrain3d.shader, terrain3d.with_texture_loc, (int[1]){0}, SHADER_UNIFORM_INT);
+  
+  basic2d.shader = LoadShader(0, TextFormat("./res/shaders/%i_basic2d.fs", GLSL_VERSION));
+  basic2d.color_depth_loc = GetShaderLocation(basic2d.shader, "color_depth");
+  
+  SetShaderValue(basic2d.shader, basic2d.color_depth_loc, (float[3]){COLOR_DEPTH_R, COLOR_DEPTH_G, COLOR_DEPTH_B}, SHADER_UNIFORM_VEC3);
+  
+  mesh_pool_start(); //chunk meshes are requested by sim_handoff, nearest first
+  
   Image test_image;
   test_image = LoadImage("./res/textures/purp.png");
   test_object.animations[0].frame_index = 0;
@@ -526,14 +1977,30 @@ void setup() {
   test_object.animations[1].frame_index = 0;
   test_object.animations[1].texture = LoadTextureFromImage(test_image);
   UnloadImage(test_image);
-  test_object.tint = (Color){0xff, 0xff, 0xff, 0xff};
-  
-  cam_point.follow_obj = &test_object;
+}
+
+void setup() {
+  setup_world();
+  setup_graphics();
+  sim_publish(frame_states); //both frames, the first handoff swaps in the back one
+  sim_publish(frame_states + 1);
+  job_system_start(job_cpu_count() - 1); //the thread running update helps with its own jobs
+  sim_start();
 }
 
 void cleanup() {
+  sim_stop();
+  job_system_stop();
+  for (int i = 0; i < c_retired_meshes; i++)
+    unload_terrain_mesh(retired_meshes + i);
+  c_retired_meshes = 0;
+  mesh_pool_stop();
+  for (int i = 0; i < chunk_cache.c_chunks; i++)
+    unload_terrain_mesh(&chunk_cache.chunks[i].mesh);
   UnloadShader(basic3d.shader);
+  UnloadShader(terrain3d.shader);
   UnloadShader(basic2d.shader);
+  cleanup_world();
 }
 
 void process_keyboard() {
@@ -565,16 +2032,26 @@ void process_keyboard() {
   
   if (IsKeyPressed(KEY_Y)) {
     SetShaderValue(basic3d.shader, basic3d.light_intensity_loc, (float[1]){light_switch ? 12000.0f : INV_DIVINE * 10.0f}, SHADER_UNIFORM_FLOAT);
+    SetShaderValue(terrain3d.shader, terrain3d.light_intensity_loc, (float[1]){light_switch ? 12000.0f : INV_DIVINE * 10.0f}, SHADER_UNIFORM_FLOAT);
     light_switch = !light_switch;
   }
   
-  if (IsKeyDown(KEY_SPACE)) {
-    test_object.g_speed -= 30.0f * delta;
-    test_object.animation_index = 1;
-    test_object.animations[test_object.animation_index].frame_index += 10.0f * delta;
+  if (IsKeyDown(KEY_SPACE))
+    input.jetpack = true;
+  
+  if (IsKeyDown(KEY_R))
+    input.terrain_edit += 1.0f;
+  if (IsKeyDown(KEY_F))
+    input.terrain_edit -= 1.0f;
+  
+#ifdef PROFILER
+  if (IsKeyPressed(KEY_F3))
+    prof.overlay = !prof.overlay;
+  if (IsKeyPressed(KEY_F4)) {
+    prof_export_csv("profile.csv");
+    prof_export_trace("profile.json");
   }
-  else
-    test_object.animation_index = 0;
+#endif
   
 #ifndef PLATFORM_WEB
   if (IsKeyPressed(KEY_F11)) {
@@ -627,16 +2104,8 @@ void process_touch() {
   else if (c_touch_points == 1 && IsGestureDetected(GESTURE_HOLD) && BETWEEN(GetGestureHoldDuration(), 5.0f, 5.0f + delta)) {
     for (int i = 0; i < CHUNK_SIZE_S; i++) {
       if (BETWEEN(i % CHUNK_SIZE, 1, CHUNK_SIZE - 2) && BETWEEN(i / CHUNK_SIZE, 1, CHUNK_SIZE - 2))
-        test_chunk.height_map[i] = rand() * 32.0f / (float)RAND_MAX;
+        set_tile_height(test_object.current_chunk, i % CHUNK_SIZE, i / CHUNK_SIZE, rng_float() * 32.0f);
     }
-    int c_test_vertices;
-    float *test_vertices = generate_chunk_vertices(&test_chunk, &c_test_vertices);
-    float *test_normals = malloc(c_test_vertices * sizeof(float));
-    calculate_normals(test_normals, test_vertices, c_test_vertices);
-    UpdateMeshBuffer(test_chunk.mesh, 0, test_vertices, c_test_vertices * sizeof(float), 0);
-    UpdateMeshBuffer(test_chunk.mesh, 2, test_normals, c_test_vertices * sizeof(float), 0);
-    free(test_vertices);
-    free(test_normals);
   }
   else if (c_touch_points == 2) {
     input.cam_rotate = -(touch_diffs[1].x + touch_diffs[0].x) / 2 * 0.1f;
@@ -650,6 +2119,7 @@ void process_touch() {
   }
   */
 }
+#endif
 
 void cam_point_update(Vector3 translate, float rotate, float rotate_v, float zoom_factor) {
   if (cam_point.follow_obj == NULL)
@@ -683,19 +2153,105 @@ void cam_point_update(Vector3 translate, float rotate, float rotate_v, float zoo
   //cam_point.rel_up = Vector3Normalize(Vector3CrossProduct(cam_point.forward, cam_point.left)); //for billboard up vector
 }
 
+void sort_pushers(unsigned char *order, const float *keys, int c_pushers) {
+  //shifts one byte at a time instead of a whole Pusher
+  order[0] = 0;
+  for (int i = 1; i < c_pushers; i++) {
+    float key = keys[i];
+    int j = i - 1;
+    for (; j >= 0 && keys[order[j]] > key; j--)
+      order[j + 1] = order[j];
+    order[j + 1] = i;
+  }
+}
+
+Vector2 sweep_game_object(GameObject *obj, Vector2 v, float *pos_y) {
+  //radius must stay below one tile so every touched tile is in the 3x3 around the centre's tile
+  Vector2 pos = vector3_xz(obj->pos);
+  WorldChunk *chunk = obj->current_chunk;
+  for (int e = 0; e < MAX_SWEEP_EVENTS && Vector2LengthSqr(v) > 0.0f; e++) {
+    int tile_x = floor(pos.x);
+    int tile_z = floor(pos.y);
+    int step_x = v.x > 0.0f ? 1 : -1;
+    int step_z = v.y > 0.0f ? 1 : -1;
+    float delta_x = v.x != 0.0f ? 1.0f / fabsf(v.x) : INFINITY;
+    float delta_z = v.y != 0.0f ? 1.0f / fabsf(v.y) : INFINITY;
+    float next_x = (step_x > 0 ? tile_x + 1 - pos.x : pos.x - tile_x) * delta_x;
+    float next_z = (step_z > 0 ? tile_z + 1 - pos.y : pos.y - tile_z) * delta_z;
+    float t_enter = 0.0f;
+    float hit_t = 2.0f;
+    float hit_h = 0.0f;
+    Vector2 hit_n = Vector2Zero();
+    WorldChunk *tile_chunk = chunk;
+    
+    //grid DDA over the tiles the centre crosses, until past the end or the earliest hit
+    while (t_enter <= 1.0f && t_enter <= hit_t) {
+      chunk = tile_chunk;
+      for (int z = tile_z - 1; z <= tile_z + 1; z++) {
+        for (int x = tile_x - 1; x <= tile_x + 1; x++) {
+          float h = get_tile_height(tile_chunk, x, z);
+          if (h <= *pos_y)
+            continue;
+          Vector2 n;
+          float t = sweep_circle_rect(pos, v, obj->radius, (Vector2){x, z}, (Vector2){x + 1, z + 1}, &n);
+          if (t < hit_t) {
+            hit_t = t;
+            hit_h = h;
+            hit_n = n;
+          }
+        }
+      }
+      Vector2 edge_n;
+      if (next_x < next_z) {
+        tile_x += step_x;
+        t_enter = next_x;
+        next_x += delta_x;
+        edge_n = (Vector2){-step_x, 0.0f};
+      }
+      else {
+        tile_z += step_z;
+        t_enter = next_z;
+        next_z += delta_z;
+        edge_n = (Vector2){0.0f, -step_z};
+      }
+      if (t_enter > 1.0f || t_enter > hit_t)
+        break;
+      tile_chunk = get_chunk_at(tile_chunk, (Vector2){tile_x + 0.5f, tile_z + 0.5f});
+      if (tile_chunk == NULL) { //edge of the world acts as a wall
+        hit_t = t_enter;
+        hit_h = INFINITY;
+        hit_n = edge_n;
+        break;
+      }
+    }
+    
+    if (hit_t > 1.0f) {
+      pos = Vector2Add(pos, v);
+      break;
+    }
+    pos = Vector2Add(pos, Vector2Scale(v, hit_t));
+    v = Vector2Scale(v, 1.0f - hit_t);
+    if (hit_h <= *pos_y + STEP_SNAP_HEIGHT) {
+      *pos_y = hit_h;
+      continue;
+    }
+    pos = Vector2Add(pos, Vector2Scale(hit_n, ALMOST_ZERO));
+    v = Vector2Subtract(v, Vector2Scale(hit_n, Vector2DotProduct(v, hit_n)));
+    WorldChunk *pos_chunk = get_chunk_at(chunk, pos);
+    if (pos_chunk != NULL)
+      chunk = pos_chunk;
+  }
+  obj->current_chunk = chunk;
+  return pos;
+}
+
 void move_game_object(GameObject *obj, Vector2 v) {
   WorldChunk *new_chunk;
   Vector2 new_pos = vector3_xz(obj->pos);
   float pos_y = obj->pos.y;
-  Vector2 remaining = Vector2Zero();
   if (!Vector2Equals(v, Vector2Zero())) {
-    if (Vector2Length(v) >= obj->radius) {
-      remaining = v;
-      v = Vector2Scale(Vector2Normalize(v), obj->radius - ALMOST_ZERO); //can't be arsed to do logic for more than 1 radius per frame
-      remaining = Vector2Subtract(remaining, v);
-    }
-    new_pos = Vector2Add(new_pos, v);
     obj->last_move_dir = vector2_to_xz(Vector2Normalize(v), 0.0f);
+    new_pos = sweep_game_object(obj, v, &pos_y);
   }
   
   const int w_x[] = {0, 1, 0, -1};
@@ -703,36 +2259,67 @@ void move_game_object(GameObject *obj, Vector2 v) {
   const int p_x[] = {0, 1, 1, 0};
   const int p_y[] = {0, 0, 1, 1};
   
-  BTree pushers = btree_create(sizeof(Pusher));
-  UQueue lifters = uqueue_create(4 * 9, sizeof(Pusher));
-  Pusher pusher;
-  
-  for (float y = -1.0f; y <= 1.0f; y += 1.0f) {
-    for (float x = -1.0f; x <= 1.0f; x += 1.0f)  {
-      Vector2 trans_pos = Vector2Add(new_pos, (Vector2){x, y});
-      new_chunk = get_chunk_at(obj->current_chunk, trans_pos);
-      float h = new_chunk != NULL ? get_chunk_height_at(new_chunk, trans_pos) : CHUNK_HEIGHT_CAP;
-      for (int i = 0; i < 4; i++) {
-        pusher.v1.x = x + floor(new_pos.x) + p_x[i];
-        pusher.v1.y = y + floor(new_pos.y) + p_y[i];
-        pusher.v2.x = x + floor(new_pos.x) + p_x[(i + 1) % 4];
-        pusher.v2.y = y + floor(new_pos.y) + p_y[(i + 1) % 4];
-        pusher.normal = (Vector2){w_x[i], w_y[i]};
-        pusher.p = closest_point_on_line(pusher.v1, pusher.v2, new_pos);
-        pusher.h = h;
-        btree_push(&pushers, Vector2LengthSqr(Vector2Subtract(pusher.p, new_pos)), &pusher);
-      }
+  PusherLanes lanes;
+  unsigned char order[MAX_PUSHERS];
+  int c_pushers = 0;
+  unsigned char lifters[MAX_PUSHERS];
+  int c_lifters = 0;
+  
+  //heights of the 3x3 around the swept position; with nothing to push out of and nothing
+  //higher than the centre there is nothing to settle, which is the common case on open ground
+  float hs[9];
+  bool walled = false;
+  bool level = true;
+  for (int i = 0; i < 9; i++) {
+    Vector2 trans_pos = Vector2Add(new_pos, (Vector2){i % 3 - 1, i / 3 - 1});
+    new_chunk = get_chunk_at(obj->current_chunk, trans_pos);
+    hs[i] = new_chunk != NULL ? get_chunk_height_at(new_chunk, trans_pos) : CHUNK_HEIGHT_CAP;
+    walled |= pos_y + STEP_SNAP_HEIGHT < hs[i];
+  }
+  for (int i = 0; i < 9; i++)
+    level &= hs[i] <= hs[4];
+  
+  //settle at the swept position: push out of walls and find what can be stood on
+  for (int t = 0; t < 9 && !(level && !walled); t++) {
+    float x = t % 3 - 1;
+    float y = t / 3 - 1;
+    for (int i = 0; i < 4; i++) {
+      lanes.v1_x[c_pushers] = x + floor(new_pos.x) + p_x[i];
+      lanes.v1_y[c_pushers] = y + floor(new_pos.y) + p_y[i];
+      lanes.v2_x[c_pushers] = x + floor(new_pos.x) + p_x[(i + 1) % 4];
+      lanes.v2_y[c_pushers] = y + floor(new_pos.y) + p_y[(i + 1) % 4];
+      lanes.dir_x[c_pushers] = w_x[i];
+      lanes.dir_y[c_pushers] = w_y[i];
+      lanes.h[c_pushers++] = hs[t];
     }
   }
-  while (btree_pop_low(&pushers, &pusher)) {
-    pusher.p = closest_point_on_line(pusher.v1, pusher.v2, new_pos);
-    Vector2 c = unclipping_vector(new_pos, obj->radius, pusher.p, pusher.normal);
+  if (c_pushers > 0) {
+    closest_points_on_lines(lanes.v1_x, lanes.v1_y, lanes.v2_x, lanes.v2_y, new_pos, lanes.p_x, lanes.p_y, lanes.dist_sqr, c_pushers);
+    unclipping_vectors(new_pos, obj->radius, lanes.p_x, lanes.p_y, lanes.dist_sqr, lanes.dir_x, lanes.dir_y, lanes.push_x, lanes.push_y, c_pushers);
+  }
+  //only walls move new_pos and one can only push if it is already within reach, otherwise the order
+  //can't change which pushers lift; the sweep stops short of walls, so this is rarely needed
+  bool pushing = false;
+  for (int k = 0; k < c_pushers && !pushing; k++)
+    pushing = pos_y + STEP_SNAP_HEIGHT < lanes.h[k] && sqrtf(lanes.dist_sqr[k]) < obj->radius;
+  if (pushing)
+    sort_pushers(order, lanes.dist_sqr, c_pushers);
+  else
+    for (int i = 0; i < c_pushers; i++)
+      order[i] = i;
+  for (int i = 0; i < c_pushers; i++) {
+    int k = order[i];
+    Vector2 c = {lanes.push_x[k], lanes.push_y[k]};
     if (Vector2LengthSqr(c) == 0.0f)
       continue;
-    if (pos_y + STEP_SNAP_HEIGHT < pusher.h)
+    if (pos_y + STEP_SNAP_HEIGHT < lanes.h[k]) {
+      //the order stays as sorted, only the closest points and pushes follow the object
       new_pos = Vector2Add(new_pos, c);
+      closest_points_on_lines(lanes.v1_x, lanes.v1_y, lanes.v2_x, lanes.v2_y, new_pos, lanes.p_x, lanes.p_y, lanes.dist_sqr, c_pushers);
+      unclipping_vectors(new_pos, obj->radius, lanes.p_x, lanes.p_y, lanes.dist_sqr, lanes.dir_x, lanes.dir_y, lanes.push_x, lanes.push_y, c_pushers);
+    }
     else
-      uqueue_push(&lifters, &pusher);
+      lifters[c_lifters++] = k;
   }
   
   new_chunk = get_chunk_at(obj->current_chunk, new_pos);
@@ -742,74 +2329,367 @@ void move_game_object(GameObject *obj, Vector2 v) {
   obj->pos = vector2_to_xz(new_pos, pos_y);
   
   float highest_point = get_chunk_height_at(obj->current_chunk, new_pos);
-  while (uqueue_pop(&lifters, &pusher)) {
-    pusher.p = closest_point_on_line(pusher.v1, pusher.v2, new_pos);
-    float dist_sqr = Vector2LengthSqr(Vector2Subtract(pusher.p, new_pos));
-    if (dist_sqr >= pow(obj->radius, 2))
+  for (int i = 0; i < c_lifters; i++) {
+    //the lanes were last updated for the final new_pos
+    int k = lifters[i];
+    if (lanes.dist_sqr[k] >= pow(obj->radius, 2))
       continue;
-    if (highest_point < pusher.h)
-      highest_point = pusher.h;
+    if (highest_point < lanes.h[k])
+      highest_point = lanes.h[k];
   }
-  btree_destroy(&pushers);
-  uqueue_destroy(&lifters);
-  
-  bool repeat = !Vector2Equals(remaining, Vector2Zero());
   
-  if (!repeat) {
-    if (highest_point < pos_y)
-      obj->g_speed += GRAVITY * delta;
-    pos_y -= obj->g_speed * delta;
-  }
+  if (highest_point < pos_y)
+    obj->g_speed += GRAVITY * delta;
+  pos_y -= obj->g_speed * delta;
   if (highest_point > pos_y) {
     obj->g_speed = 0.0f;
     pos_y = highest_point;
   }
   obj->pos.y = pos_y;
-    
-  if (repeat)
-    move_game_object(obj, remaining);
 }
 
-void draw_background() {
-  float mul = 0.125 / cam_point.rot_v_pi;
+void update_npcs() {
+  NPCStore *s = &object_keeper.npcs;
+  //every NPC only writes its own columns and terrain is read-only until stream_chunks,
+  //so the result doesn't depend on how the range is split or which thread runs it;
+  //pushes are all found from the positions before anyone moves for the same reason
+  job_parallel_for(push_npc_range, NULL, s->c_active, NPC_JOB_GRAIN);
+  job_parallel_for(update_npc_range, NULL, s->c_active, NPC_JOB_GRAIN);
+  for (int i = 0; i < s->c_active; i++)
+    update_npc_cell(i);
+}
+
+void push_npc_range(void *data, int start, int end) {
+  NPCStore *s = &object_keeper.npcs;
+  for (int i = start; i < end; i++) {
+    int slot = s->handle[i] & ((1u << NPC_SLOT_BITS) - 1);
+    Vector2 push = get_npc_push(s->pos_x[i], s->pos_z[i], s->radius[i], slot);
+    //the player gives way by the other half in update
+    float dx = s->pos_x[i] - test_object.pos.x;
+    float dz = s->pos_z[i] - test_object.pos.z;
+    float d = sqrtf(dx * dx + dz * dz);
+    float overlap = s->radius[i] + test_object.radius - d;
+    if (overlap > 0.0f) {
+      push.x += d > 0.0f ? dx / d * overlap * 0.5f : overlap * 0.5f;
+      push.y += d > 0.0f ? dz / d * overlap * 0.5f : 0.0f;
+    }
+    s->push_x[i] = push.x;
+    s->push_z[i] = push.y;
+  }
+}
+
+void update_npc_range(void *data, int start, int end) {
+  NPCStore *s = &object_keeper.npcs;
+  GameObject body; //stands in for an NPC while move_game_object runs, only movement fields are set
+  //resting NPCs are only looked at again on a turn, in case the ground under them changed
+  unsigned char skip = next_turn ? 0 : NPC_SETTLED;
+  for (int i = start; i < end; i++) {
+    //chunks get evicted, so the one under an NPC is looked up from its position rather than kept
+    bool pushed = s->push_x[i] != 0.0f || s->push_z[i] != 0.0f;
+    WorldChunk *chunk = s->flags[i] & skip && !pushed ? NULL : find_chunk(floorf(s->pos_x[i] / CHUNK_SIZE), floorf(s->pos_z[i] / CHUNK_SIZE));
+    if (chunk != NULL) { //with nothing loaded to stand on, wait for the chunk
+      body.current_chunk = chunk;
+      body.pos = (Vector3){s->pos_x[i], s->pos_y[i], s->pos_z[i]};
+      body.radius = s->radius[i];
+      body.g_speed = s->g_speed[i];
+      body.last_move_dir = (Vector3){s->dir_x[i], 0.0f, s->dir_z[i]};
+      move_game_object(&body, (Vector2){s->vel_x[i] * delta + s->push_x[i], s->vel_z[i] * delta + s->push_z[i]});
+      s->pos_x[i] = body.pos.x;
+      s->pos_y[i] = body.pos.y;
+      s->pos_z[i] = body.pos.z;
+      s->g_speed[i] = body.g_speed;
+      s->dir_x[i] = body.last_move_dir.x;
+      s->dir_z[i] = body.last_move_dir.z;
+    }
+    bool still = s->vel_x[i] == 0.0f && s->vel_z[i] == 0.0f;
+    s->frame_index[i] = still ? 0.0f : s->frame_index[i] + NPC_ANIMATION_SPEED * delta;
+    s->flags[i] = still && !pushed && s->g_speed[i] == 0.0f ? s->flags[i] | NPC_SETTLED : s->flags[i] & ~NPC_SETTLED;
+  }
+}
+
+void update() {
+  next_turn = false;
+  turn_keeper += delta * TPS;
+  if (turn_keeper >= 1.0f) {
+    turn_keeper -= 1.0f;
+    next_turn = true;
+  }
+  
+  if (input.jetpack) {
+    test_object.g_speed -= 30.0f * delta;
+    test_object.animation_index = 1;
+    test_object.animations[test_object.animation_index].frame_index += 10.0f * delta;
+  }
+  else
+    test_object.animation_index = 0;
+  
+  if (input.terrain_edit != 0.0f) {
+    int x = floor(test_object.pos.x);
+    int z = floor(test_object.pos.z);
+    float h = get_tile_height(test_object.current_chunk, x, z) + input.terrain_edit * delta;
+    set_terrain_height(test_object.current_chunk, x - 1, z - 1, 3, 3, MIN(h, test_object.current_chunk->max_height));
+  }
+  
+  Vector2 move = Vector2Scale(vector3_xz(input.move_translate), delta);
+  Vector2 push = get_npc_push(test_object.pos.x, test_object.pos.z, test_object.radius, -1);
+  if (push.x != 0.0f || push.y != 0.0f) //only touched beside an NPC, keeps -0 moves as they were
+    move = Vector2Add(move, push);
+  PROF_ZONE(PROF_MOVE)
+    move_game_object(&test_object, move);
+  PROF_ZONE(PROF_NPCS) {
+    //off screen NPCs only keep walking on turns
+    if (next_turn)
+      update_dormant_npcs();
+    update_npc_activation();
+    update_npcs();
+  }
+  WorldChunk *chunk = test_object.current_chunk;
+  if (chunk->w_pos[0] != chunk_cache.center[0] || chunk->w_pos[1] != chunk_cache.center[1])
+    stream_chunks(chunk);
+  
+  if (test_object.animation_index == 0) {
+    if (Vector3Equals(input.move_translate, Vector3Zero()))
+      test_object.animations[test_object.animation_index].frame_index = 0.0f;
+    else
+      test_object.animations[test_object.animation_index].frame_index += 10.0f * delta;
+  }
+  PROF_ZONE(PROF_CAMERA)
+    cam_point_update(Vector3Scale(input.move_translate, delta), input.cam_rotate * delta, input.cam_rotate_v * delta, input.zoom_factor * delta);
+  refresh_active_chunks(test_object.current_chunk);
+}
+
+SimState sim_capture() {
+  return (SimState){test_object.pos, cam_point.cam.position, cam_point.cam.target, cam_point.cam.fovy};
+}
+
+void sim_apply(FrameState *frame, SimState state) {
+  frame->object.pos = state.object_pos;
+  frame->cam_point.cam.position = state.cam_position;
+  frame->cam_point.cam.target = state.cam_target;
+  frame->cam_point.cam.fovy = state.cam_fovy;
+}
+
+SimState sim_lerp(SimState from, SimState to, float alpha) {
+  return (SimState){
+    Vector3Lerp(from.object_pos, to.object_pos, alpha),
+    Vector3Lerp(from.cam_position, to.cam_position, alpha),
+    Vector3Lerp(from.cam_target, to.cam_target, alpha),
+    Lerp(from.cam_fovy, to.cam_fovy, alpha)
+  };
+}
+
+void sim_publish(FrameState *frame) {
+  frame->prev = sim_prev;
+  frame->state = sim_capture();
+  frame->object = test_object;
+  frame->cam_point = cam_point;
+  frame->next_turn = next_turn;
+  frame->c_chunks = active_chunks.c_chunks;
+  for (int i = 0; i < active_chunks.c_chunks; i++) {
+    WorldChunk *chunk = active_chunks.chunks[i];
+    //walls reach down to the west and north neighbours' heights
+    float min_y = chunk->min_height;
+    if (chunk->neighbours[CARDINAL_WEST] != NULL)
+      min_y = MIN(min_y, chunk->neighbours[CARDINAL_WEST]->min_height);
+    if (chunk->neighbours[CARDINAL_NORTH] != NULL)
+      min_y = MIN(min_y, chunk->neighbours[CARDINAL_NORTH]->min_height);
+    frame->chunks[i] = (RenderChunk){chunk, min_y, chunk->max_height};
+  }
+}
+
+void sim_steps(int c_steps) {
+  for (int i = 0; i < c_steps; i++) {
+    sim_prev = sim_capture();
+    delta = SIM_STEP;
+    const ReplayFrame *played = replay_next(&replay);
+    if (played != NULL)
+      replay_apply(played);
+    update();
+    if (played != NULL)
+      replay_check(played);
+    else if (replay.file != NULL) {
+      ReplayFrame frame = replay_capture();
+      replay_write(&replay, &frame);
+    }
+  }
+  sim_publish(frame_states + (front_frame ^ 1));
+}
+
+#if SIM_THREAD
+void *sim_thread(void *arg) {
+  PROF_SET_THREAD(MESH_WORKERS + 1);
+  pthread_mutex_lock(&sim_worker.lock);
+  while (true) {
+    while (!sim_worker.quit && !sim_worker.busy)
+      pthread_cond_wait(&sim_worker.wake, &sim_worker.lock);
+    if (sim_worker.quit)
+      break;
+    pthread_mutex_unlock(&sim_worker.lock);
+    sim_steps(sim_worker.c_steps);
+    pthread_mutex_lock(&sim_worker.lock);
+    sim_worker.busy = false;
+    pthread_cond_signal(&sim_worker.done);
+  }
+  pthread_mutex_unlock(&sim_worker.lock);
+  return NULL;
+}
+#endif
+
+void sim_start() {
+#if SIM_THREAD
+  if (!sim_pipelined)
+    return;
+  pthread_mutex_init(&sim_worker.lock, NULL);
+  pthread_cond_init(&sim_worker.wake, NULL);
+  pthread_cond_init(&sim_worker.done, NULL);
+  sim_worker.busy = false;
+  sim_worker.quit = false;
+  sim_worker.running = pthread_create(&sim_worker.thread, NULL, sim_thread, NULL) == 0;
+  sim_pipelined = sim_worker.running;
+#endif
+}
+
+void sim_stop() {
+#if SIM_THREAD
+  if (!sim_worker.running)
+    return;
+  pthread_mutex_lock(&sim_worker.lock);
+  sim_worker.quit = true;
+  pthread_cond_signal(&sim_worker.wake);
+  pthread_mutex_unlock(&sim_worker.lock);
+  pthread_join(sim_worker.thread, NULL); //a running batch finishes first
+  pthread_mutex_destroy(&sim_worker.lock);
+  pthread_cond_destroy(&sim_worker.wake);
+  pthread_cond_destroy(&sim_worker.done);
+  sim_worker.running = false;
+#endif
+}
+
+void sim_kick(int c_steps) {
+#if SIM_THREAD
+  pthread_mutex_lock(&sim_worker.lock);
+  sim_worker.c_steps = c_steps;
+  sim_worker.busy = true;
+  pthread_cond_signal(&sim_worker.wake);
+  pthread_mutex_unlock(&sim_worker.lock);
+#endif
+}
+
+void sim_wait() {
+#if SIM_THREAD
+  if (!sim_worker.running)
+    return;
+  pthread_mutex_lock(&sim_worker.lock);
+  while (sim_worker.busy)
+    pthread_cond_wait(&sim_worker.done, &sim_worker.lock);
+  pthread_mutex_unlock(&sim_worker.lock);
+#endif
+}
+
+void replay_apply(const ReplayFrame *frame) {
+  delta = frame->delta;
+  input.move_speed = frame->move_speed;
+  input.move_translate = (Vector3){frame->move_translate[0], frame->move_translate[1], frame->move_translate[2]};
+  input.cam_rotate = frame->cam_rotate;
+  input.cam_rotate_v = frame->cam_rotate_v;
+  input.zoom_factor = frame->zoom_factor;
+  input.terrain_edit = frame->terrain_edit;
+  input.jetpack = frame->flags & REPLAY_JETPACK;
+}
+
+ReplayFrame replay_capture() {
+  return (ReplayFrame){
+    delta, input.move_speed,
+    {input.move_translate.x, input.move_translate.y, input.move_translate.z},
+    input.cam_rotate, input.cam_rotate_v, input.zoom_factor, input.terrain_edit,
+    input.jetpack ? REPLAY_JETPACK : 0,
+    {test_object.pos.x, test_object.pos.y, test_object.pos.z}
+  };
+}
+
+bool replay_check(const ReplayFrame *frame) {
+  //memcmp so -0.0f and NaN count as changes too
+  float pos[3] = {test_object.pos.x, test_object.pos.y, test_object.pos.z};
+  if (memcmp(pos, frame->pos, sizeof(pos)) == 0)
+    return true;
+  if (replay_first_divergence < 0)
+    replay_first_divergence = frame - replay.frames;
+  replay_divergences++;
+  return false;
+}
+
+#ifndef HEADLESS
+void sim_handoff() {
+  front_frame ^= 1;
+  FrameState *frame = frame_states + front_frame;
+  frame_epoch++;
+  for (int i = 0; i < frame->c_chunks; i++) {
+    WorldChunk *chunk = frame->chunks[i].chunk;
+    chunk->render_epoch = frame_epoch;
+    if (chunk->mesh_stale && !chunk->meshing && mesh_pool_request(chunk)) {
+      chunk->mesh_stale = false;
+      chunk->meshing = true;
+    }
+  }
+  for (int i = 0; i < c_retired_meshes; i++)
+    unload_terrain_mesh(retired_meshes + i);
+  c_retired_meshes = 0;
+  PROF_ZONE(PROF_UPLOAD) {
+    upload_chunk_meshes(MESH_UPLOADS_PER_FRAME);
+    flush_terrain_edits();
+  }
+}
+
+void draw_background(const CamPoint *cam) {
+  float mul = 0.125 / cam->rot_v_pi;
   BeginShaderMode(basic2d.shader);
   DrawRectangleGradientV(0, 0, GAME_W, GAME_H * 4 * mul / 7, color_d(0x99 / 3, 0x0, 0xff / 3, 0xff), BLACK);
   EndShaderMode();
 }
 
-void draw_chunks(WorldChunk *origin) {
-  uqueue_push(&active_chunks, &origin);
-  WorldChunk *chunk;
-  bool full = false;
-  while (!full && uqueue_pop(&active_chunks, &chunk)) {
-    for (int i = 0; i < 4; i++) {
-      WorldChunk *c = chunk->neighbours[i];
-      if (c != NULL && !uqueue_push(&active_chunks, &c))
-        full = true;
-    }
+bool is_chunk_visible(const RenderChunk *chunk, Vector3 center, const Vector3 *axes, Vector3 half) {
+  Vector3 min = {chunk->chunk->w_pos[0] * CHUNK_SIZE, chunk->min_y, chunk->chunk->w_pos[1] * CHUNK_SIZE};
+  Vector3 max = {min.x + CHUNK_SIZE, chunk->max_y, min.z + CHUNK_SIZE};
+  return box_overlaps_obb(min, max, center, axes, half);
+}
+
+void draw_chunks(const FrameState *frame) {
+  //orthographic view volume as an oriented box around the middle of the depth range
+  const float near = RL_CULL_DISTANCE_NEAR;
+  const float far = RL_CULL_DISTANCE_FAR;
+  Vector3 axes[3];
+  const CamPoint *cam = &frame->cam_point;
+  axes[0] = cam->left;
+  axes[2] = cam->forward;
+  axes[1] = Vector3CrossProduct(axes[2], axes[0]);
+  Vector3 half = {cam->cam.fovy * 0.5f * GAME_W / GAME_H, cam->cam.fovy * 0.5f, (far - near) * 0.5f};
+  Vector3 center = Vector3Add(cam->cam.position, Vector3Scale(axes[2], (near + far) * 0.5f));
+  c_considered_chunks = 0;
+  c_drawn_chunks = 0;
+  
+  for (int i = 0; i < frame->c_chunks; i++) {
+    WorldChunk *chunk = frame->chunks[i].chunk;
+    c_considered_chunks++;
+    if (!is_chunk_visible(frame->chunks + i, center, axes, half))
+      continue;
+    draw_terrain_mesh(&chunk->mesh, (Vector3){chunk->w_pos[0] * CHUNK_SIZE, 0.0f, chunk->w_pos[1] * CHUNK_SIZE}, chunk->tint);
+    c_drawn_chunks++;
   }
-  uqueue_restore(&active_chunks);
-  while (uqueue_pop(&active_chunks, &chunk))
-    DrawModel(chunk->model, (Vector3){chunk->w_pos[0] * CHUNK_SIZE, 0.0f, chunk->w_pos[1] * CHUNK_SIZE}, 1.0f, chunk->tint);
-  uqueue_reset(&active_chunks);
 }
 
-Rectangle get_game_object_frame(GameObject *obj) {
+Rectangle get_game_object_frame(const GameObject *obj, const CamPoint *cam) {
   Rectangle frame = {0};
   frame.width = obj->sprite_size[0];
   frame.height = obj->sprite_size[1];
-  Animation *anim = obj->animations + obj->animation_index;
-  frame.x = (int)anim->frame_index * obj->sprite_size[0];
-  if (frame.x >= anim->texture.width) {
-    frame.x = 0.0f;
-    anim->frame_index -= (float)anim->texture.width / obj->sprite_size[0];
-  }
+  const Animation *anim = obj->animations + obj->animation_index;
+  int c_frames = MAX(anim->texture.width / obj->sprite_size[0], 1);
+  frame.x = (int)fmodf(anim->frame_index, c_frames) * obj->sprite_size[0]; //wraps without writing back, obj may be a snapshot
   if (obj->c_facings < 2)
     frame.y = 0.0f;
   else {
     int facing_index = -1;
     float max_dot = -1.0f;
-    Vector2 rotated_dir = Vector2Rotate(vector3_xz(obj->last_move_dir), cam_point.rot_pi * PI);
+    Vector2 rotated_dir = Vector2Rotate(vector3_xz(obj->last_move_dir), cam->rot_pi * PI);
     for (int i = 0; i < obj->c_facings; i++) {
       float dot = Vector2DotProduct(vector3_xz(obj->facings[i]), rotated_dir);
       dot = round(dot * 100.0f) / 100.0f;
@@ -823,27 +2703,25 @@ Rectangle get_game_object_frame(GameObject *obj) {
   return frame;
 }
 
-void draw_game_object(GameObject *obj) {
+void draw_game_object(const GameObject *obj, const CamPoint *cam) {
   DrawBillboardPro(
-    cam_point.cam,
+    cam->cam,
     obj->animations[obj->animation_index].texture,
-    get_game_object_frame(obj),
-    Vector3Add(obj->pos, (Vector3){0.0f, (float)obj->sprite_size[1] / 2 / TILE_SIZE / cam_point.cos_rot_v, 0.0f}),
+    get_game_object_frame(obj, cam),
+    Vector3Add(obj->pos, (Vector3){0.0f, (float)obj->sprite_size[1] / 2 / TILE_SIZE / cam->cos_rot_v, 0.0f}),
     (Vector3){0.0f, 1.0f, 0.0f}, //cam_point.rel_up,
-    (Vector2){MAX(obj->sprite_size[0], obj->sprite_size[1]) / TILE_SIZE, MAX(obj->sprite_size[0], obj->sprite_size[1]) / TILE_SIZE / cam_point.cos_rot_v},
+    (Vector2){MAX(obj->sprite_size[0], obj->sprite_size[1]) / TILE_SIZE, MAX(obj->sprite_size[0], obj->sprite_size[1]) / TILE_SIZE / cam->cos_rot_v},
     (Vector2){0.0f, 0.0f},
     0.0f, obj->tint
   );
 }
 
 void update_draw() {
-  delta = GetFrameTime();
-  next_turn = false;
-  turn_keeper += delta * TPS;
-  if (turn_keeper >= 1.0f) {
-    turn_keeper -= 1.0f;
-    next_turn = true;
-  }
+  PROF_FRAME_BEGIN();
+  sim_wait(); //from here until sim_kick the main thread owns the simulation state
+  begin_frame();
+  delta = GetFrameTime(); //input sees the frame time, steps see SIM_STEP
+  sim_accumulator = MIN(sim_accumulator + delta, SIM_MAX_STEPS * SIM_STEP);
   screen_scale = MIN((float)get_screen_width() / GAME_W, (float)get_screen_height() / GAME_H);
   
   input.move_speed = INV_DIVINE * 10.0f;
@@ -851,74 +2729,119 @@ void update_draw() {
   input.cam_rotate = 0.0f;
   input.cam_rotate_v = 0.0f;
   input.zoom_factor = 0.0f;
+  input.terrain_edit = 0.0f;
+  input.jetpack = false;
   
+  PROF_ZONE(PROF_INPUT) {
 #ifndef PLATFORM_ANDROID
-  process_keyboard();
-  process_mouse();
+    process_keyboard();
+    process_mouse();
 #endif
-  process_controller();
+    process_controller();
 #if defined(PLATFORM_WEB) || defined(PLATFORM_ANDROID)
-  process_touch();
+    process_touch();
 #endif
+  }
   
   //update
-  move_game_object(&test_object, Vector2Scale(vector3_xz(input.move_translate), delta));
+  int c_steps = sim_accumulator / SIM_STEP;
+  sim_accumulator -= c_steps * SIM_STEP;
+  if (!sim_pipelined)
+    sim_steps(c_steps);
+  sim_handoff();
+  const char *replay_text = NULL;
+  if (replay.file != NULL)
+    replay_text = TextFormat("rec %i", replay.c_frames);
+  else if (replay.frames != NULL)
+    replay_text = TextFormat("replay %i/%i, %i diverged", replay.cursor, replay.c_frames, replay_divergences);
+  if (sim_pipelined)
+    sim_kick(c_steps); //the simulation now runs ahead while this frame draws the front frame only
   
-  if (test_object.animation_index == 0) {
-    if (Vector3Equals(input.move_translate, Vector3Zero()))
-      test_object.animations[test_object.animation_index].frame_index = 0.0f;
-    else
-      test_object.animations[test_object.animation_index].frame_index += 10.0f * delta;
-  }
-  cam_point_update(Vector3Scale(input.move_translate, delta), input.cam_rotate * delta, input.cam_rotate_v * delta, input.zoom_factor * delta);
+  //draw between the front frame's last two steps
+  FrameState *frame = frame_states + front_frame;
+  const CamPoint *cam = &frame->cam_point;
+  sim_apply(frame, sim_lerp(frame->prev, frame->state, sim_accumulator / SIM_STEP));
   
   if (light_switch) {
-    SetShaderValue(basic3d.shader, basic3d.light_src_loc, &cam_point.cam.target, SHADER_UNIFORM_VEC3);
+    SetShaderValue(basic3d.shader, basic3d.light_src_loc, &cam->cam.target, SHADER_UNIFORM_VEC3);
+    SetShaderValue(terrain3d.shader, terrain3d.light_src_loc, &cam->cam.target, SHADER_UNIFORM_VEC3);
   }
   else {
     float light_source[3] = {
-      cam_point.cam.target.x + sin(GetTime() / 20) * 10000.0f,
-      cam_point.cam.target.y + cos(GetTime() / 20) * 10000.0f,
-      cam_point.cam.target.z + cos(GetTime() / 80) * 2000.0f
+      cam->cam.target.x + sin(GetTime() / 20) * 10000.0f,
+      cam->cam.target.y + cos(GetTime() / 20) * 10000.0f,
+      cam->cam.target.z + cos(GetTime() / 80) * 2000.0f
     };
     SetShaderValue(basic3d.shader, basic3d.light_src_loc, light_source, SHADER_UNIFORM_VEC3);
+    SetShaderValue(terrain3d.shader, terrain3d.light_src_loc, light_source, SHADER_UNIFORM_VEC3);
   }
 
   //draw
   BeginTextureMode(render_target);
     ClearBackground(BLACK);
-    draw_background();
-    BeginMode3D(cam_point.cam);
-      SetShaderValue(basic3d.shader, basic3d.with_texture_loc, (int[1]){0}, SHADER_UNIFORM_INT);
-      draw_chunks(test_object.current_chunk);
-      BeginShaderMode(basic3d.shader);
-        SetShaderValue(basic3d.shader, basic3d.with_texture_loc, (int[1]){1}, SHADER_UNIFORM_INT);
-        draw_game_object(&test_object);
-      EndShaderMode();
+    draw_background(cam);
+    BeginMode3D(cam->cam);
+      PROF_ZONE(PROF_CHUNKS)
+        draw_chunks(frame);
+      PROF_ZONE(PROF_BILLBOARDS) { //draw zones time CPU-side submission, not the GPU
+        BeginShaderMode(basic3d.shader);
+          SetShaderValue(basic3d.shader, basic3d.with_texture_loc, (int[1]){1}, SHADER_UNIFORM_INT);
+          draw_game_object(&frame->object, cam);
+        EndShaderMode();
+      }
     EndMode3D();
   EndTextureMode();
   
   BeginDrawing();
     ClearBackground(BLACK);
-    DrawTexturePro(
-      render_target.texture,
-      (Rectangle){0.0f, 0.0f, (float)render_target.texture.width, (float)-render_target.texture.height},
-      (Rectangle){(get_screen_width() - ((float)GAME_W * screen_scale)) * 0.5f, (get_screen_height() - ((float)GAME_H * screen_scale)) * 0.5f,
-      (float)GAME_W * screen_scale, (float)GAME_H * screen_scale}, (Vector2){0, 0}, 0.0f, WHITE
-    );
+    PROF_ZONE(PROF_BLIT)
+      DrawTexturePro(
+        render_target.texture,
+        (Rectangle){0.0f, 0.0f, (float)render_target.texture.width, (float)-render_target.texture.height},
+        (Rectangle){(get_screen_width() - ((float)GAME_W * screen_scale)) * 0.5f, (get_screen_height() - ((float)GAME_H * screen_scale)) * 0.5f,
+        (float)GAME_W * screen_scale, (float)GAME_H * screen_scale}, (Vector2){0, 0}, 0.0f, WHITE
+      );
     DrawFPS(10, 10);
-    DrawText(TextFormat("xz(%.2f; %.2f)", cam_point.cam.target.x, cam_point.cam.target.z), 10, 40, 20, color_d(0xff, 0xff, 0x0, 0xff));
-    DrawText(TextFormat("cam(%.2f; %.2f, %.2f)", cam_point.rot_pi, cam_point.rot_v_pi, cam_point.zoom), 10, 70, 20, color_d(0xff, 0xff, 0x0, 0xff));
+    DrawText(TextFormat("xz(%.2f; %.2f)", cam->cam.target.x, cam->cam.target.z), 10, 40, 20, color_d(0xff, 0xff, 0x0, 0xff));
+    DrawText(TextFormat("cam(%.2f; %.2f, %.2f)", cam->rot_pi, cam->rot_v_pi, cam->zoom), 10, 70, 20, color_d(0xff, 0xff, 0x0, 0xff));
     DrawText(light_switch ? "Torch" : "Sun", 10, 100, 20, color_d(0xff, 0xff, 0xff, 0xff));
-    DrawText(TextFormat("%x", test_object.current_chunk), 10, 130, 20, color_d(0xcc, 0xff, 0xcc, 0xff));
-    if (next_turn)
+    DrawText(TextFormat("%x", frame->object.current_chunk), 10, 130, 20, color_d(0xcc, 0xff, 0xcc, 0xff));
+    if (frame->next_turn)
       DrawText("boop", 10, 160, 20, color_d(0xcc, 0xcc, 0xff, 0xff));
     // DrawText(TextFormat("%f", get_chunk_height_at(test_object.current_chunk, vector3_xz(test_object.pos))), 10, 190, 20, color_d(0xcc, 0xcc, 0xff, 0xff));
-    DrawText("WASD IJKL GT Y", 10, get_screen_height() - 30, 20, WHITE);
-  EndDrawing(); 
+    DrawText(TextFormat("chunks %i/%i", c_drawn_chunks, c_considered_chunks), 10, 190, 20, color_d(0xcc, 0xff, 0xcc, 0xff));
+    DrawText(TextFormat("allocator-tracked allocs %lu (%lu B)", frame_alloc_calls, frame_alloc_bytes), 10, 220, 20, color_d(0xcc, 0xff, 0xcc, 0xff));
+    if (replay_text != NULL)
+      DrawText(replay_text, 10, 250, 20, color_d(0xff, 0x66, 0x66, 0xff));
+    DrawText("WASD IJKL GT Y RF", 10, get_screen_height() - 30, 20, WHITE);
+#ifdef PROFILER
+    prof_draw_overlay(get_screen_width() - PROF_HISTORY * 2 - 10, 10);
+#endif
+  EndDrawing();
+  PROF_FRAME_END();
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+  //args
+  const char *record_path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-single") == 0)
+      sim_pipelined = false;
+    else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+      record_path = argv[++i];
+    else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+      world_seed = strtoul(argv[++i], NULL, 0);
+    else if (strcmp(argv[i], "-replay") == 0 && i + 1 < argc) {
+      if (!replay_load(&replay, argv[++i])) {
+        fprintf(stderr, "could not load replay %s\n", argv[i]);
+        return 1;
+      }
+      world_seed = replay.rng_seed;
+    }
+  }
+  if (record_path != NULL && replay.frames == NULL && !replay_record(&replay, record_path, world_seed))
+    fprintf(stderr, "could not record to %s\n", record_path);
+  
   //init
 #ifdef PLATFORM_WEB
   SetConfigFlags(FLAG_WINDOW_RESIZABLE);
@@ -958,8 +2881,12 @@ int main(void) {
   
   //deinit
   cleanup();
+  if (replay.frames != NULL)
+    printf("replay %d/%d frames, %d diverged (first %d)\n", replay.cursor, replay.c_frames, replay_divergences, replay_first_divergence);
+  replay_close(&replay);
   UnloadRenderTexture(render_target);
   CloseWindow();
   
   return 0;
 }
+#endif
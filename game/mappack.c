@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "raylib.h"
+
+#include "maps.h"
+#include "mappack.h"
+
+#define PACK_CHUNK_SIZE 16 //must match CHUNK_SIZE in main.c
+#define PACK_CHUNK_SIZE_S (PACK_CHUNK_SIZE * PACK_CHUNK_SIZE)
+#define PACK_MAX_HEIGHT 5.0f
+#define PACK_HEIGHT_LIMIT 127.0f //TERRAIN_Y_LIMIT in main.c rounded down, higher heights don't fit the packed vertices
+#define MAX_PACK_CHUNKS 4096
+
+typedef struct SourceMap SourceMap;
+typedef struct PackChunk PackChunk;
+
+struct SourceMap {
+  int w_pos[2];
+  const float *height_map;
+};
+
+struct PackChunk {
+  MapPackEntry entry;
+  unsigned char tint[4];
+  float height_map[PACK_CHUNK_SIZE_S];
+};
+
+//Height maps compiled in from maps.h.
+const SourceMap source_maps[] = {
+  {{0, 0}, test_0_0_height_map}
+};
+
+PackChunk *pack_chunks;
+int c_pack_chunks = 0;
+
+bool add_chunk(int x, int z, const float *height_map, const unsigned char *tint) {
+  for (int i = 0; i < c_pack_chunks; i++) {
+    if (pack_chunks[i].entry.w_pos[0] == x && pack_chunks[i].entry.w_pos[1] == z) {
+      fprintf(stderr, "mappack: chunk (%d, %d) given twice\n", x, z);
+      return false;
+    }
+  }
+  if (c_pack_chunks == MAX_PACK_CHUNKS) {
+    fprintf(stderr, "mappack: more than %d chunks\n", MAX_PACK_CHUNKS);
+    return false;
+  }
+  PackChunk *chunk = pack_chunks + c_pack_chunks++;
+  chunk->entry.w_pos[0] = x;
+  chunk->entry.w_pos[1] = z;
+  memcpy(chunk->tint, tint, 4);
+  memcpy(chunk->height_map, height_map, PACK_CHUNK_SIZE_S * sizeof(float));
+  return true;
+}
+
+//Splits a height map image into chunks starting at (x, z), red channel 0-255 mapped onto 0-scale.
+bool add_image(int x, int z, const char *path, float scale) {
+  if (!(scale >= 0.0f && scale <= PACK_HEIGHT_LIMIT)) {
+    fprintf(stderr, "mappack: height scale %g of %s is outside 0-%g\n", scale, path, PACK_HEIGHT_LIMIT);
+    return false;
+  }
+  Image image = LoadImage(path);
+  if (image.data == NULL || image.width % PACK_CHUNK_SIZE != 0 || image.height % PACK_CHUNK_SIZE != 0) {
+    fprintf(stderr, "mappack: %s must be a readable image with sides in multiples of %d\n", path, PACK_CHUNK_SIZE);
+    UnloadImage(image);
+    return false;
+  }
+  Color *colors = LoadImageColors(image);
+  const unsigned char tint[] = {0xff, 0xff, 0xff, 0xff};
+  bool ok = true;
+  for (int c_z = 0; ok && c_z < image.height / PACK_CHUNK_SIZE; c_z++) {
+    for (int c_x = 0; ok && c_x < image.width / PACK_CHUNK_SIZE; c_x++) {
+      float height_map[PACK_CHUNK_SIZE_S];
+      for (int i = 0; i < PACK_CHUNK_SIZE_S; i++) {
+        int p_x = c_x * PACK_CHUNK_SIZE + i % PACK_CHUNK_SIZE;
+        int p_z = c_z * PACK_CHUNK_SIZE + i / PACK_CHUNK_SIZE;
+        height_map[i] = colors[p_z * image.width + p_x].r * scale / 255.0f;
+      }
+      ok = add_chunk(x + c_x, z + c_z, height_map, tint);
+    }
+  }
+  UnloadImageColors(colors);
+  UnloadImage(image);
+  return ok;
+}
+
+bool write_pack(const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "mappack: cannot write %s\n", path);
+    return false;
+  }
+  qsort(pack_chunks, c_pack_chunks, sizeof(PackChunk), map_pack_compare); //entry is the first member
+  MapPackHeader header = {MAP_PACK_MAGIC, MAP_PACK_VERSION, PACK_CHUNK_SIZE, c_pack_chunks};
+  fwrite(&header, sizeof(header), 1, file);
+  unsigned int offset = sizeof(MapPackHeader) + c_pack_chunks * sizeof(MapPackEntry);
+  for (int i = 0; i < c_pack_chunks; i++) {
+    pack_chunks[i].entry.offset = offset;
+    fwrite(&pack_chunks[i].entry, sizeof(MapPackEntry), 1, file);
+    offset += map_pack_chunk_bytes(PACK_CHUNK_SIZE);
+  }
+  for (int i = 0; i < c_pack_chunks; i++) {
+    PackChunk *chunk = pack_chunks + i;
+    MapPackChunk packed = {PACK_MAX_HEIGHT, chunk->height_map[0]};
+    for (int j = 1; j < PACK_CHUNK_SIZE_S; j++)
+      packed.min_height = chunk->height_map[j] < packed.min_height ? chunk->height_map[j] : packed.min_height;
+    memcpy(packed.tint, chunk->tint, 4);
+    fwrite(&packed, sizeof(MapPackChunk), 1, file);
+    fwrite(chunk->height_map, sizeof(float), PACK_CHUNK_SIZE_S, file);
+  }
+  bool ok = ferror(file) == 0;
+  fclose(file);
+  printf("mappack: wrote %d chunks, %u bytes to %s\n", c_pack_chunks, offset, path);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2 || (argc - 2) % 4 != 0) {
+    fprintf(stderr, "usage: %s <out.pack> [<x> <z> <heightmap image> <height scale>]...\n", argv[0]);
+    return 1;
+  }
+  pack_chunks = malloc(MAX_PACK_CHUNKS * sizeof(PackChunk));
+  const unsigned char header_tint[] = {0xcc, 0xcc, 0xcc, 0xff};
+  bool ok = true;
+  for (int i = 0; ok && i < sizeof(source_maps) / sizeof(SourceMap); i++)
+    ok = add_chunk(source_maps[i].w_pos[0], source_maps[i].w_pos[1], source_maps[i].height_map, header_tint);
+  for (int i = 2; ok && i < argc; i += 4)
+    ok = add_image(atoi(argv[i]), atoi(argv[i + 1]), argv[i + 2], atof(argv[i + 3]));
+  ok = ok && write_pack(argv[1]);
+  free(pack_chunks);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+#ifndef MAPPACK_H
+#define MAPPACK_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#ifdef _WIN32
+  #define MAP_PACK_NO_MMAP
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+#define MAP_PACK_MAGIC 0x504d5953u //"SYMP" as a little-endian word
+#define MAP_PACK_VERSION 1
+
+//File layout, native (little) endian, every part 4-byte aligned:
+//MapPackHeader, c_chunks MapPackEntry sorted by w_pos, then the MapPackChunk data they point at.
+
+typedef struct MapPackHeader MapPackHeader;
+typedef struct MapPackEntry MapPackEntry;
+typedef struct MapPackChunk MapPackChunk;
+typedef struct MapPack MapPack;
+
+struct MapPackHeader {
+  unsigned int magic;
+  unsigned int version;
+  int chunk_size; //tiles along each side of a chunk
+  int c_chunks;
+};
+
+struct MapPackEntry {
+  int w_pos[2];
+  unsigned int offset; //from the start of the file to the entry's MapPackChunk
+};
+
+struct MapPackChunk {
+  float max_height;
+  float min_height;
+  unsigned char tint[4];
+  float height_map[]; //chunk_size * chunk_size heights, row by row
+};
+
+struct MapPack {
+  unsigned char *data;
+  size_t size;
+  int chunk_size;
+  int c_chunks;
+  const MapPackEntry *entries;
+};
+
+size_t map_pack_chunk_bytes(int chunk_size); //Size of one packed chunk.
+int map_pack_compare(const void *a, const void *b); //Index order of two entries, by z then x.
+bool map_pack_open(MapPack *pack, const char *path); //Map a pack file read-only and check its header and index fit.
+void map_pack_close(MapPack *pack); //Unmap a pack file.
+const MapPackChunk *map_pack_find(const MapPack *pack, int x, int z); //Binary search the index for a chunk, NULL if it is not packed.
+
+size_t map_pack_chunk_bytes(int chunk_size) {
+  return sizeof(MapPackChunk) + (size_t)chunk_size * chunk_size * sizeof(float);
+}
+
+int map_pack_compare(const void *a, const void *b) {
+  const MapPackEntry *e1 = a;
+  const MapPackEntry *e2 = b;
+  if (e1->w_pos[1] != e2->w_pos[1])
+    return e1->w_pos[1] < e2->w_pos[1] ? -1 : 1;
+  if (e1->w_pos[0] != e2->w_pos[0])
+    return e1->w_pos[0] < e2->w_pos[0] ? -1 : 1;
+  return 0;
+}
+
+bool map_pack_open(MapPack *pack, const char *path) {
+  *pack = (MapPack){0};
+#ifdef MAP_PACK_NO_MMAP
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return false;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (size < (long)sizeof(MapPackHeader)) {
+    fclose(file);
+    return false;
+  }
+  pack->data = malloc(size);
+  pack->size = fread(pack->data, 1, size, file);
+  fclose(file);
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(MapPackHeader)) {
+    close(fd);
+    return false;
+  }
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  pack->data = data;
+  pack->size = st.st_size;
+#endif
+  const MapPackHeader *header = (const MapPackHeader *)pack->data;
+  size_t index_end = sizeof(MapPackHeader) + (size_t)header->c_chunks * sizeof(MapPackEntry);
+  if (pack->size < sizeof(MapPackHeader) || header->magic != MAP_PACK_MAGIC || header->version != MAP_PACK_VERSION
+    || header->chunk_size <= 0 || header->c_chunks < 0 || index_end > pack->size) {
+    map_pack_close(pack);
+    return false;
+  }
+  pack->chunk_size = header->chunk_size;
+  pack->c_chunks = header->c_chunks;
+  pack->entries = (const MapPackEntry *)(pack->data + sizeof(MapPackHeader));
+  return true;
+}
+
+void map_pack_close(MapPack *pack) {
+  if (pack->data != NULL) {
+#ifdef MAP_PACK_NO_MMAP
+    free(pack->data);
+#else
+    munmap(pack->data, pack->size);
+#endif
+  }
+  *pack = (MapPack){0};
+}
+
+const MapPackChunk *map_pack_find(const MapPack *pack, int x, int z) {
+  MapPackEntry key = {{x, z}, 0};
+  int low = 0;
+  int high = pack->c_chunks - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    int cmp = map_pack_compare(&key, pack->entries + mid);
+    if (cmp == 0) {
+      unsigned int offset = pack->entries[mid].offset;
+      if (offset % 4 != 0 || offset + map_pack_chunk_bytes(pack->chunk_size) > pack->size)
+        return NULL; //truncated or corrupt entry
+      return (const MapPackChunk *)(pack->data + offset);
+    }
+    if (cmp < 0)
+      high = mid - 1;
+    else
+      low = mid + 1;
+  }
+  return NULL;
+}
+
+#endif
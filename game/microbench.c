@@ -0,0 +1,333 @@
+#define HEADLESS
+#include "main.c"
+#include "bench.h"
+
+#define MICRO_MIN_NS 20000000LL //each case repeats until it has run this long
+#define MICRO_BATCH 16 //rounds between clock reads
+#define MICRO_MAX_N 2048
+#define MICRO_MAX_RESULTS 128
+#ifndef MICRO_REV
+  #define MICRO_REV "unknown"
+#endif
+
+typedef struct Micro Micro;
+typedef struct MicroResult MicroResult;
+
+struct Micro {
+  const char *name;
+  void (*setup)(int n); //Untimed preparation before the rounds.
+  int (*run)(int n); //Runs one round and returns how many operations it did.
+  void (*teardown)(); //Untimed cleanup after the rounds.
+};
+
+struct MicroResult {
+  const char *name;
+  int n;
+  double ns_per_op;
+  double allocs_per_op;
+};
+
+DECLARE_PQUEUE(PusherQueue, pusher_queue, Pusher, MEMORY_EQ)
+
+WorldChunk *micro_chunks[MICRO_MAX_N]; //fake addresses, never dereferenced
+float micro_keys[MICRO_MAX_N];
+Pusher micro_pushers[MICRO_MAX_N];
+Vector2 micro_points[MICRO_MAX_N];
+float micro_v1_x[MICRO_MAX_N]; //micro_pushers' ends in SoA lanes
+float micro_v1_y[MICRO_MAX_N];
+float micro_v2_x[MICRO_MAX_N];
+float micro_v2_y[MICRO_MAX_N];
+float micro_near_x[MICRO_MAX_N];
+float micro_near_y[MICRO_MAX_N];
+float micro_dist_sqr[MICRO_MAX_N];
+float micro_dir_x[MICRO_MAX_N]; //push directions for unclipping_vectors, all (0, 1) like run_unclipping_vector
+float micro_dir_y[MICRO_MAX_N];
+float micro_push_x[MICRO_MAX_N];
+float micro_push_y[MICRO_MAX_N];
+UQueue micro_uqueue;
+ChunkQueue micro_chunk_queue;
+PQueue micro_pqueue;
+PusherQueue micro_pusher_queue;
+volatile float micro_sink; //keeps results of pure functions alive
+
+MicroResult micro_results[MICRO_MAX_RESULTS];
+int c_micro_results = 0;
+
+void micro_fill(int n, bool sorted) {
+  rng_seed(RNG_SEED);
+  for (int i = 0; i < n; i++) {
+    micro_chunks[i] = (WorldChunk *)((uintptr_t)(i + 1) * sizeof(WorldChunk));
+    micro_keys[i] = sorted ? (float)i : rng_float() * n;
+    micro_pushers[i] = (Pusher){{rng_float(), rng_float()}, {rng_float(), rng_float()}};
+    micro_points[i] = (Vector2){rng_float() * CHUNK_SIZE, rng_float() * CHUNK_SIZE};
+    micro_v1_x[i] = micro_pushers[i].v1.x;
+    micro_dir_x[i] = 0.0f;
+    micro_dir_y[i] = 1.0f;
+    micro_v1_y[i] = micro_pushers[i].v1.y;
+    micro_v2_x[i] = micro_pushers[i].v2.x;
+    micro_v2_y[i] = micro_pushers[i].v2.y;
+  }
+}
+
+void setup_unique(int n) {
+  micro_fill(n, false);
+  micro_uqueue = uqueue_create_mode(n, sizeof(WorldChunk *), UQUEUE_UNIQUE);
+}
+
+void setup_hashed(int n) {
+  micro_fill(n, false);
+  micro_uqueue = uqueue_create_mode(n, sizeof(WorldChunk *), UQUEUE_HASHED);
+}
+
+void setup_typed_hashed(int n) {
+  micro_fill(n, false);
+  micro_chunk_queue = chunk_queue_create(n, UQUEUE_HASHED);
+}
+
+void setup_filled_hashed(int n) {
+  setup_hashed(n);
+  for (int i = 0; i < n; i++)
+    uqueue_push(&micro_uqueue, micro_chunks + i);
+}
+
+void setup_pqueue_random(int n) {
+  micro_fill(n, false);
+  micro_pqueue = pqueue_create(n, sizeof(Pusher));
+  micro_pusher_queue = pusher_queue_create(n);
+}
+
+void setup_pqueue_sorted(int n) {
+  micro_fill(n, true);
+  micro_pqueue = pqueue_create(n, sizeof(Pusher));
+  micro_pusher_queue = pusher_queue_create(n);
+}
+
+void setup_filled_pqueue(int n) {
+  setup_pqueue_random(n);
+  for (int i = 0; i < n; i++)
+    pqueue_push(&micro_pqueue, micro_keys[i], micro_pushers + i);
+}
+
+void setup_points(int n) {
+  micro_fill(n, false);
+}
+
+void setup_world_points(int n) {
+  setup_world();
+  micro_fill(n, false);
+}
+
+void teardown_uqueue() {
+  uqueue_destroy(&micro_uqueue);
+}
+
+void teardown_chunk_queue() {
+  chunk_queue_destroy(&micro_chunk_queue);
+}
+
+void teardown_pqueue() {
+  pqueue_destroy(&micro_pqueue);
+  pusher_queue_destroy(&micro_pusher_queue);
+}
+
+void teardown_none() {
+}
+
+int run_uqueue_push(int n) {
+  uqueue_reset(&micro_uqueue);
+  for (int i = 0; i < n; i++)
+    uqueue_push(&micro_uqueue, micro_chunks + i);
+  return n;
+}
+
+int run_chunk_queue_push(int n) {
+  chunk_queue_reset(&micro_chunk_queue);
+  for (int i = 0; i < n; i++)
+    chunk_queue_push(&micro_chunk_queue, micro_chunks[i]);
+  return n;
+}
+
+int run_uqueue_push_duplicate(int n) {
+  for (int i = 0; i < n; i++)
+    uqueue_push(&micro_uqueue, micro_chunks + i);
+  return n;
+}
+
+int run_uqueue_pop(int n) {
+  WorldChunk *chunk;
+  uqueue_restore(&micro_uqueue);
+  while (uqueue_pop(&micro_uqueue, &chunk));
+  return n;
+}
+
+int run_uqueue_shift(int n) {
+  //steady state of a work queue, each op is a push, a pop and a shift
+  WorldChunk *chunk;
+  for (int i = 0; i < n; i++) {
+    uqueue_pop(&micro_uqueue, &chunk);
+    uqueue_shift(&micro_uqueue);
+    uqueue_push(&micro_uqueue, &chunk);
+  }
+  return n;
+}
+
+int run_uqueue_copy(int n) {
+  UQueue q = uqueue_copy(&micro_uqueue);
+  uqueue_destroy(&q);
+  return 1;
+}
+
+int run_pqueue_push(int n) {
+  pqueue_reset(&micro_pqueue);
+  for (int i = 0; i < n; i++)
+    pqueue_push(&micro_pqueue, micro_keys[i], micro_pushers + i);
+  return n;
+}
+
+int run_pusher_queue_push(int n) {
+  pusher_queue_reset(&micro_pusher_queue);
+  for (int i = 0; i < n; i++)
+    pusher_queue_push(&micro_pusher_queue, micro_keys[i], micro_pushers[i]);
+  return n;
+}
+
+int run_pqueue_pop_low(int n) {
+  //each op is a push and a pop_low
+  Pusher pusher;
+  for (int i = 0; i < n; i++)
+    pqueue_push(&micro_pqueue, micro_keys[i], micro_pushers + i);
+  while (pqueue_pop_low(&micro_pqueue, &pusher));
+  return n;
+}
+
+int run_pusher_queue_pop_low(int n) {
+  Pusher pusher;
+  for (int i = 0; i < n; i++)
+    pusher_queue_push(&micro_pusher_queue, micro_keys[i], micro_pushers[i]);
+  while (pusher_queue_pop_low(&micro_pusher_queue, &pusher));
+  return n;
+}
+
+int run_pqueue_contains(int n) {
+  int found = 0;
+  for (int i = 0; i < n; i++)
+    found += pqueue_contains(&micro_pqueue, micro_keys[i], micro_pushers + i);
+  micro_sink = found;
+  return n;
+}
+
+int run_closest_point_on_line(int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; i++) {
+    Pusher *pusher = micro_pushers + i;
+    sum += closest_point_on_line(pusher->v1, pusher->v2, micro_points[i]).x;
+  }
+  micro_sink = sum;
+  return n;
+}
+
+int run_closest_points_on_lines(int n) {
+  closest_points_on_lines(micro_v1_x, micro_v1_y, micro_v2_x, micro_v2_y, micro_points[0], micro_near_x, micro_near_y, micro_dist_sqr, n);
+  micro_sink = micro_dist_sqr[n - 1];
+  return n;
+}
+
+int run_unclipping_vector(int n) {
+  float sum = 0.0f;
+  for (int i = 0; i < n; i++) {
+    Vector2 near = closest_point_on_line(micro_pushers[i].v1, micro_pushers[i].v2, micro_points[i]);
+    sum += unclipping_vector(micro_points[i], 0.5f, near, (Vector2){0.0f, 1.0f}).y;
+  }
+  micro_sink = sum;
+  return n;
+}
+
+int run_unclipping_vectors(int n) {
+  closest_points_on_lines(micro_v1_x, micro_v1_y, micro_v2_x, micro_v2_y, micro_points[0], micro_near_x, micro_near_y, micro_dist_sqr, n);
+  unclipping_vectors(micro_points[0], 0.5f, micro_near_x, micro_near_y, micro_dist_sqr, micro_dir_x, micro_dir_y, micro_push_x, micro_push_y, n);
+  micro_sink = micro_push_y[n - 1];
+  return n;
+}
+
+int run_get_chunk_height_at(int n) {
+  float sum = 0.0f;
+  WorldChunk *chunk = test_object.current_chunk;
+  for (int i = 0; i < n; i++)
+    sum += get_chunk_height_at(chunk, micro_points[i]);
+  micro_sink = sum;
+  return n;
+}
+
+void teardown_world() {
+  cleanup_world();
+}
+
+void run_micro(Micro *m, int n) {
+  m->setup(n);
+  m->run(n); //warm up
+  long ops = 0;
+  unsigned long allocs = bench_allocs;
+  long long start = bench_now();
+  long long elapsed;
+  do {
+    for (int i = 0; i < MICRO_BATCH; i++) //keeps clock reads out of small cases
+      ops += m->run(n);
+    elapsed = bench_now() - start;
+  } while (elapsed < MICRO_MIN_NS);
+  allocs = bench_allocs - allocs;
+  m->teardown();
+  if (c_micro_results < MICRO_MAX_RESULTS)
+    micro_results[c_micro_results++] = (MicroResult){m->name, n, (double)elapsed / ops, (double)allocs / ops};
+}
+
+void print_table() {
+  printf("%-28s %5s %12s %12s\n", "case", "n", "ns/op", "allocs/op");
+  for (int i = 0; i < c_micro_results; i++) {
+    MicroResult *r = micro_results + i;
+    printf("%-28s %5d %12.2f %12.4f\n", r->name, r->n, r->ns_per_op, r->allocs_per_op);
+  }
+}
+
+void print_json() {
+  printf("{\n  \"rev\": \"%s\",\n  \"results\": [\n", MICRO_REV);
+  for (int i = 0; i < c_micro_results; i++) {
+    MicroResult *r = micro_results + i;
+    printf("    {\"name\": \"%s\", \"n\": %d, \"ns_per_op\": %.3f, \"allocs_per_op\": %.4f}%s\n",
+      r->name, r->n, r->ns_per_op, r->allocs_per_op, i + 1 < c_micro_results ? "," : "");
+  }
+  printf("  ]\n}\n");
+}
+
+int main(int argc, char **argv) {
+  bool json = argc > 1 && strcmp(argv[1], "-json") == 0;
+  Micro micros[] = {
+    {"uqueue_push_unique", setup_unique, run_uqueue_push, teardown_uqueue},
+    {"uqueue_push_hashed", setup_hashed, run_uqueue_push, teardown_uqueue},
+    {"chunk_queue_push_hashed", setup_typed_hashed, run_chunk_queue_push, teardown_chunk_queue},
+    {"uqueue_push_duplicate", setup_filled_hashed, run_uqueue_push_duplicate, teardown_uqueue},
+    {"uqueue_pop", setup_filled_hashed, run_uqueue_pop, teardown_uqueue},
+    {"uqueue_shift", setup_filled_hashed, run_uqueue_shift, teardown_uqueue},
+    {"uqueue_copy", setup_filled_hashed, run_uqueue_copy, teardown_uqueue},
+    {"pqueue_push_random", setup_pqueue_random, run_pqueue_push, teardown_pqueue},
+    {"pqueue_push_sorted", setup_pqueue_sorted, run_pqueue_push, teardown_pqueue},
+    {"pusher_queue_push_random", setup_pqueue_random, run_pusher_queue_push, teardown_pqueue},
+    {"pqueue_pop_low_random", setup_pqueue_random, run_pqueue_pop_low, teardown_pqueue},
+    {"pqueue_pop_low_sorted", setup_pqueue_sorted, run_pqueue_pop_low, teardown_pqueue},
+    {"pusher_queue_pop_low_random", setup_pqueue_random, run_pusher_queue_pop_low, teardown_pqueue},
+    {"pqueue_contains_random", setup_filled_pqueue, run_pqueue_contains, teardown_pqueue},
+    {"closest_point_on_line", setup_points, run_closest_point_on_line, teardown_none},
+    {"closest_points_on_lines", setup_points, run_closest_points_on_lines, teardown_none},
+    {"unclipping_vector", setup_points, run_unclipping_vector, teardown_none},
+    {"unclipping_vectors", setup_points, run_unclipping_vectors, teardown_none},
+    {"get_chunk_height_at", setup_world_points, run_get_chunk_height_at, teardown_world}
+  };
+  const int sizes[] = {4, 36, 256, MICRO_MAX_N};
+  for (int i = 0; i < sizeof(micros) / sizeof(Micro); i++)
+    for (int j = 0; j < sizeof(sizes) / sizeof(int); j++)
+      run_micro(micros + i, sizes[j]);
+  if (json)
+    print_json();
+  else
+    print_table();
+  return 0;
+}
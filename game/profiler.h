@@ -0,0 +1,202 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+//Frame profiler, built only with -DPROFILER. Without it every PROF_* macro is empty
+//and PROF_ZONE(z) { ... } is a plain block.
+#ifdef PROFILER
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include "raylib.h"
+
+#define PROF_MAX_EVENTS 8192 //power of two
+#define PROF_HISTORY 120 //frames kept for the frame-time graph
+#define PROF_GRAPH_MS 33.3f //frame time at the top of the graph
+
+typedef struct ProfEvent ProfEvent;
+typedef struct ProfMark ProfMark;
+typedef struct Profiler Profiler;
+
+typedef enum {
+  PROF_INPUT = 0,
+  PROF_MOVE,
+  PROF_NPCS,
+  PROF_CAMERA,
+  PROF_UPLOAD,
+  PROF_CHUNKS,
+  PROF_BILLBOARDS,
+  PROF_BLIT,
+  PROF_MESH_BUILD, //mesh workers, overlaps the main thread zones
+  PROF_ZONE_COUNT
+} ProfZone;
+
+struct ProfEvent {
+  unsigned int seq; //ring position + 1 once the event is complete, 0 while written, so each lap has its own value
+  unsigned char zone;
+  unsigned char thread;
+  unsigned int frame;
+  long long start;
+  long long end;
+};
+
+struct ProfMark {
+  ProfZone zone;
+  long long start;
+  bool active;
+};
+
+struct Profiler {
+  ProfEvent events[PROF_MAX_EVENTS];
+  unsigned int head; //events ever claimed, writers take slots with an atomic add
+  unsigned int frame;
+  long long frame_start;
+  long long zone_ns[PROF_ZONE_COUNT]; //this frame so far
+  long long last_zone_ns[PROF_ZONE_COUNT];
+  float frame_ms[PROF_HISTORY];
+  int c_frames;
+  bool overlay;
+};
+
+const char *prof_zone_names[PROF_ZONE_COUNT] = {"input", "move", "npcs", "camera", "upload", "chunks", "billboards", "blit", "mesh_build"};
+
+Profiler prof = {0};
+_Thread_local unsigned char prof_thread = 0; //0 is the main thread
+
+long long prof_now(); //Returns a monotonic time in nanoseconds.
+ProfMark prof_begin(ProfZone zone); //Opens a zone, see PROF_ZONE.
+void prof_end(ProfMark *mark); //Closes a zone and records it into the ring.
+void prof_frame_begin(); //Starts a new frame's zone totals.
+void prof_frame_end(); //Finishes the frame and pushes its time into the graph history.
+void prof_draw_overlay(int x, int y); //Draws per-zone ms and the frame-time graph.
+bool prof_read_event(unsigned int i, ProfEvent *e); //Copies the event at ring position i, false when it is being written or a later lap replaced it.
+bool prof_export_csv(const char *path); //Writes the events still in the ring as CSV.
+bool prof_export_trace(const char *path); //Writes the events still in the ring as Chrome trace JSON.
+
+long long prof_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+ProfMark prof_begin(ProfZone zone) {
+  return (ProfMark){zone, prof_now(), true};
+}
+
+void prof_end(ProfMark *mark) {
+  long long end = prof_now();
+  unsigned int i = __atomic_fetch_add(&prof.head, 1, __ATOMIC_RELAXED);
+  ProfEvent *e = prof.events + (i & (PROF_MAX_EVENTS - 1));
+  //seqlock: readers that saw the old seq find it changed once they have copied the fields
+  __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&e->zone, mark->zone, __ATOMIC_RELAXED);
+  __atomic_store_n(&e->thread, prof_thread, __ATOMIC_RELAXED);
+  __atomic_store_n(&e->frame, prof.frame, __ATOMIC_RELAXED);
+  __atomic_store_n(&e->start, mark->start, __ATOMIC_RELAXED);
+  __atomic_store_n(&e->end, end, __ATOMIC_RELAXED);
+  __atomic_store_n(&e->seq, i + 1, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&prof.zone_ns[mark->zone], end - mark->start, __ATOMIC_RELAXED);
+  mark->active = false;
+}
+
+void prof_frame_begin() {
+  prof.frame++;
+  prof.frame_start = prof_now();
+}
+
+void prof_frame_end() {
+  for (int i = 0; i < PROF_ZONE_COUNT; i++)
+    prof.last_zone_ns[i] = __atomic_exchange_n(&prof.zone_ns[i], 0, __ATOMIC_RELAXED);
+  prof.frame_ms[prof.c_frames % PROF_HISTORY] = (prof_now() - prof.frame_start) / 1e6f;
+  prof.c_frames++;
+}
+
+#ifndef HEADLESS
+void prof_draw_overlay(int x, int y) {
+  if (!prof.overlay)
+    return;
+  const int graph_h = 60;
+  DrawRectangle(x - 4, y - 4, PROF_HISTORY * 2 + 8, graph_h + 8 + PROF_ZONE_COUNT * 12, (Color){0x00, 0x00, 0x00, 0xaa});
+  for (int i = 0; i < PROF_HISTORY && i < prof.c_frames; i++) {
+    //oldest on the left
+    float ms = prof.frame_ms[(prof.c_frames - 1 - i) % PROF_HISTORY];
+    int h = fminf(ms / PROF_GRAPH_MS, 1.0f) * graph_h;
+    Color c = ms > PROF_GRAPH_MS / 2 ? (Color){0xff, 0x66, 0x44, 0xff} : (Color){0x66, 0xff, 0x88, 0xff};
+    DrawRectangle(x + (PROF_HISTORY - 1 - i) * 2, y + graph_h - h, 2, h, c);
+  }
+  DrawLine(x, y + graph_h / 2, x + PROF_HISTORY * 2, y + graph_h / 2, (Color){0xff, 0xff, 0xff, 0x66}); //PROF_GRAPH_MS / 2
+  for (int i = 0; i < PROF_ZONE_COUNT; i++)
+    DrawText(TextFormat("%-10s %6.3f ms", prof_zone_names[i], prof.last_zone_ns[i] / 1e6), x, y + graph_h + 4 + i * 12, 10, WHITE);
+}
+#endif
+
+bool prof_read_event(unsigned int i, ProfEvent *e) {
+  ProfEvent *src = prof.events + (i & (PROF_MAX_EVENTS - 1));
+  if (__atomic_load_n(&src->seq, __ATOMIC_ACQUIRE) != i + 1)
+    return false;
+  e->zone = __atomic_load_n(&src->zone, __ATOMIC_RELAXED);
+  e->thread = __atomic_load_n(&src->thread, __ATOMIC_RELAXED);
+  e->frame = __atomic_load_n(&src->frame, __ATOMIC_RELAXED);
+  e->start = __atomic_load_n(&src->start, __ATOMIC_RELAXED);
+  e->end = __atomic_load_n(&src->end, __ATOMIC_RELAXED);
+  //a writer that lapped the ring while the fields were copied has changed seq by now
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  e->seq = __atomic_load_n(&src->seq, __ATOMIC_RELAXED);
+  return e->seq == i + 1;
+}
+
+bool prof_export_csv(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+    return false;
+  fprintf(file, "frame,thread,zone,start_ns,duration_ns\n");
+  unsigned int head = __atomic_load_n(&prof.head, __ATOMIC_ACQUIRE);
+  unsigned int first = head > PROF_MAX_EVENTS ? head - PROF_MAX_EVENTS : 0;
+  for (unsigned int i = first; i < head; i++) {
+    ProfEvent e;
+    if (!prof_read_event(i, &e))
+      continue; //still being written, or already replaced
+    fprintf(file, "%u,%u,%s,%lld,%lld\n", e.frame, e.thread, prof_zone_names[e.zone], e.start, e.end - e.start);
+  }
+  fclose(file);
+  return true;
+}
+
+bool prof_export_trace(const char *path) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+    return false;
+  fprintf(file, "{\"traceEvents\": [\n");
+  unsigned int head = __atomic_load_n(&prof.head, __ATOMIC_ACQUIRE);
+  unsigned int first = head > PROF_MAX_EVENTS ? head - PROF_MAX_EVENTS : 0;
+  bool comma = false;
+  for (unsigned int i = first; i < head; i++) {
+    ProfEvent e;
+    if (!prof_read_event(i, &e))
+      continue;
+    fprintf(file, "%s  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, \"args\": {\"frame\": %u}}",
+      comma ? ",\n" : "", prof_zone_names[e.zone], e.thread, e.start / 1e3, (e.end - e.start) / 1e3, e.frame);
+    comma = true;
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  return true;
+}
+
+//Times the statement or block that follows as one zone (leave it with break or return and the zone is lost).
+#define PROF_ZONE(z) for (ProfMark _prof_mark = prof_begin(z); _prof_mark.active; prof_end(&_prof_mark))
+#define PROF_FRAME_BEGIN() prof_frame_begin()
+#define PROF_FRAME_END() prof_frame_end()
+#define PROF_SET_THREAD(t) (prof_thread = (t))
+
+#else
+
+#define PROF_ZONE(z)
+#define PROF_FRAME_BEGIN()
+#define PROF_FRAME_END()
+#define PROF_SET_THREAD(t)
+
+#endif
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+#define REPLAY_MAGIC 0x50525953u //"SYRP" as a little-endian word
+#define REPLAY_VERSION 1
+
+//File layout, native (little) endian: ReplayHeader, then one ReplayFrame per simulated frame
+//until the end of the file, so a recording cut short by a crash still plays.
+
+typedef struct ReplayHeader ReplayHeader;
+typedef struct ReplayFrame ReplayFrame;
+typedef struct Replay Replay;
+
+typedef enum {
+  REPLAY_JETPACK = 1 << 0
+} ReplayFlags;
+
+struct ReplayHeader {
+  unsigned int magic;
+  unsigned int version;
+  unsigned int rng_seed; //world seed the recording started from
+  unsigned int frame_size; //sizeof(ReplayFrame), rejects files from another layout
+};
+
+struct ReplayFrame {
+  float delta;
+  float move_speed;
+  float move_translate[3];
+  float cam_rotate;
+  float cam_rotate_v;
+  float zoom_factor;
+  float terrain_edit;
+  unsigned int flags; //ReplayFlags
+  float pos[3]; //followed object after the frame, to compare runs with
+};
+
+struct Replay {
+  FILE *file; //open while recording
+  ReplayFrame *frames; //loaded for playback
+  unsigned int rng_seed;
+  int c_frames;
+  int cursor;
+};
+
+bool replay_record(Replay *replay, const char *path, unsigned int rng_seed); //Start recording frames to a file.
+void replay_write(Replay *replay, const ReplayFrame *frame); //Append a frame to a recording.
+bool replay_load(Replay *replay, const char *path); //Read a whole recording for playback.
+const ReplayFrame *replay_next(Replay *replay); //Returns the next recorded frame, NULL once all were played.
+void replay_close(Replay *replay); //Finish a recording or free a loaded one.
+
+bool replay_record(Replay *replay, const char *path, unsigned int rng_seed) {
+  *replay = (Replay){0};
+  replay->file = fopen(path, "wb");
+  if (replay->file == NULL)
+    return false;
+  ReplayHeader header = {REPLAY_MAGIC, REPLAY_VERSION, rng_seed, sizeof(ReplayFrame)};
+  fwrite(&header, sizeof(header), 1, replay->file);
+  replay->rng_seed = rng_seed;
+  return true;
+}
+
+void replay_write(Replay *replay, const ReplayFrame *frame) {
+  fwrite(frame, sizeof(ReplayFrame), 1, replay->file);
+  replay->c_frames++;
+}
+
+bool replay_load(Replay *replay, const char *path) {
+  *replay = (Replay){0};
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return false;
+  ReplayHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != REPLAY_MAGIC
+    || header.version != REPLAY_VERSION || header.frame_size != sizeof(ReplayFrame)) {
+    fclose(file);
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file) - (long)sizeof(header);
+  fseek(file, sizeof(header), SEEK_SET);
+  replay->c_frames = size / sizeof(ReplayFrame);
+  replay->frames = malloc((replay->c_frames > 0 ? replay->c_frames : 1) * sizeof(ReplayFrame));
+  replay->c_frames = fread(replay->frames, sizeof(ReplayFrame), replay->c_frames, file);
+  replay->rng_seed = header.rng_seed;
+  fclose(file);
+  return true;
+}
+
+const ReplayFrame *replay_next(Replay *replay) {
+  if (replay->frames == NULL || replay->cursor >= replay->c_frames)
+    return NULL;
+  return replay->frames + replay->cursor++;
+}
+
+void replay_close(Replay *replay) {
+  if (replay->file != NULL)
+    fclose(replay->file);
+  free(replay->frames);
+  *replay = (Replay){0};
+}
+
+#endif
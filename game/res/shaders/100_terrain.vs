@@ -0,0 +1,39 @@
+#version 100
+
+// Input vertex attributes: local tile x, y * 256, z and face index
+attribute vec4 vertexPosition;
+
+// Input uniform values
+uniform mat4 mvp;
+uniform mat4 matModel;
+uniform mat4 matView;
+uniform vec4 colDiffuse;
+
+// Output vertex attributes (to fragment shader)
+varying vec4 fragColor;
+varying vec2 fragTexCoord;
+
+varying vec3 frag_light_pos;
+varying vec3 frag_normal;
+uniform vec3 light_src;
+
+vec3 face_normal(float face) {
+  if (face < 0.5)
+    return vec3(0.0, 1.0, 0.0);
+  if (face < 1.5)
+    return vec3(0.0, 0.0, -1.0);
+  if (face < 2.5)
+    return vec3(1.0, 0.0, 0.0);
+  if (face < 3.5)
+    return vec3(0.0, 0.0, 1.0);
+  return vec3(-1.0, 0.0, 0.0);
+}
+
+void main() {
+  vec4 position = vec4(vertexPosition.x, vertexPosition.y / 256.0, vertexPosition.z, 1.0);
+  frag_light_pos = (matView * vec4(light_src, 1.0) - matView * matModel * position).xyz;
+  frag_normal = (matView * vec4(face_normal(vertexPosition.w), 0.0)).xyz;
+  fragColor = colDiffuse;
+  fragTexCoord = vec2(0.0);
+  gl_Position = mvp * position;
+}
\ No newline at end of file
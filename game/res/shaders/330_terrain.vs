@@ -0,0 +1,39 @@
+#version 330
+
+// Input vertex attributes: local tile x, y * 256, z and face index
+in vec4 vertexPosition;
+
+// Input uniform values
+uniform mat4 mvp;
+uniform mat4 matModel;
+uniform mat4 matView;
+uniform vec4 colDiffuse;
+
+// Output vertex attributes (to fragment shader)
+out vec4 fragColor;
+out vec2 fragTexCoord;
+
+out vec3 frag_light_pos;
+out vec3 frag_normal;
+uniform vec3 light_src;
+
+vec3 face_normal(float face) {
+  if (face < 0.5f)
+    return vec3(0.0f, 1.0f, 0.0f);
+  if (face < 1.5f)
+    return vec3(0.0f, 0.0f, -1.0f);
+  if (face < 2.5f)
+    return vec3(1.0f, 0.0f, 0.0f);
+  if (face < 3.5f)
+    return vec3(0.0f, 0.0f, 1.0f);
+  return vec3(-1.0f, 0.0f, 0.0f);
+}
+
+void main() {
+  vec4 position = vec4(vertexPosition.x, vertexPosition.y / 256.0f, vertexPosition.z, 1.0f);
+  frag_light_pos = (matView * vec4(light_src, 1.0f) - matView * matModel * position).xyz;
+  frag_normal = (matView * vec4(face_normal(vertexPosition.w), 0.0f)).xyz;
+  fragColor = colDiffuse;
+  fragTexCoord = vec2(0.0f);
+  gl_Position = mvp * position;
+}
\ No newline at end of file
@@ -4,11 +4,24 @@
 #include <math.h>
 #include "raymath.h"
 
+//SIMD for the batched kernels is picked at compile time; SYMATH_SCALAR forces the plain loop to compare against.
+//Lanes do the same IEEE operations in the same order as the scalar functions, so results are bit-identical
+//as long as the compiler isn't allowed to fuse multiplies and adds (no -mfma/-march=native with fp-contract).
+#if !defined(SYMATH_SCALAR) && (defined(__AVX2__) || defined(__SSE2__))
+  #include <immintrin.h>
+#elif !defined(SYMATH_SCALAR) && defined(__wasm_simd128__)
+  #include <wasm_simd128.h>
+#endif
+
 Vector2 vector3_xz(Vector3 v); //Returns a Vector2 consisting of x and z of a Vector3.
 Vector3 vector2_to_xz(Vector2 v, float y); //Returns a Vector3 where x, z are the x, y of a Vector2.
 Vector2 vector2_rotate_cw(Vector2 v); //Rotate a Vector2 by 90 degrees.
 Vector2 closest_point_on_line(Vector2 v1, Vector2 v2, Vector2 p); //Returns a point on a line segment from v1 to v2 that is the closest to p.
+void closest_points_on_lines(const float *v1_x, const float *v1_y, const float *v2_x, const float *v2_y, Vector2 p, float *near_x, float *near_y, float *dist_sqr, int n); //closest_point_on_line for n segments in SoA lanes, with each point's squared distance to p.
 Vector2 unclipping_vector(Vector2 p, float r, Vector2 near, Vector2 push_dir); //Returns how much a circle must move in a direction to not be clipping with a point.
+void unclipping_vectors(Vector2 p, float r, const float *near_x, const float *near_y, const float *dist_sqr, const float *dir_x, const float *dir_y, float *push_x, float *push_y, int n); //unclipping_vector for n points in SoA lanes, dist_sqr as closest_points_on_lines gives it.
+float sweep_circle_rect(Vector2 p, Vector2 d, float r, Vector2 min, Vector2 max, Vector2 *normal); //Returns the fraction of d a circle moves before touching a rectangle (> 1 if it never does).
+bool box_overlaps_obb(Vector3 min, Vector3 max, Vector3 center, const Vector3 *axes, Vector3 half); //Checks an axis-aligned box against an oriented box (unit axes, half extents), may report overlaps near edges.
 
 Vector2 vector3_xz(Vector3 v) {
   return (Vector2){v.x, v.z};
@@ -38,6 +51,113 @@ Vector2 closest_point_on_line(Vector2 v1, Vector2 v2, Vector2 p) {
   };
 }
 
+void closest_points_on_lines(const float *v1_x, const float *v1_y, const float *v2_x, const float *v2_y, Vector2 p, float *near_x, float *near_y, float *dist_sqr, int n) {
+  int i = 0;
+#if !defined(SYMATH_SCALAR) && defined(__AVX2__)
+  const __m256 px = _mm256_set1_ps(p.x);
+  const __m256 py = _mm256_set1_ps(p.y);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  for (; i + 8 <= n; i += 8) {
+    __m256 x1 = _mm256_loadu_ps(v1_x + i);
+    __m256 y1 = _mm256_loadu_ps(v1_y + i);
+    __m256 x2 = _mm256_loadu_ps(v2_x + i);
+    __m256 y2 = _mm256_loadu_ps(v2_y + i);
+    __m256 ax = _mm256_sub_ps(x2, x1);
+    __m256 ay = _mm256_sub_ps(y2, y1);
+    __m256 bx = _mm256_sub_ps(x1, px);
+    __m256 by = _mm256_sub_ps(y1, py);
+    __m256 ab = _mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by));
+    __m256 aa = _mm256_add_ps(_mm256_mul_ps(ax, ax), _mm256_mul_ps(ay, ay));
+    __m256 t = _mm256_div_ps(_mm256_xor_ps(ab, sign), aa);
+    __m256 u = _mm256_sub_ps(one, t);
+    __m256 cx = _mm256_add_ps(_mm256_mul_ps(u, x1), _mm256_mul_ps(t, x2));
+    __m256 cy = _mm256_add_ps(_mm256_mul_ps(u, y1), _mm256_mul_ps(t, y2));
+    __m256 before = _mm256_cmp_ps(t, zero, _CMP_LT_OQ);
+    __m256 after = _mm256_cmp_ps(t, one, _CMP_GT_OQ);
+    cx = _mm256_blendv_ps(_mm256_blendv_ps(cx, x2, after), x1, before);
+    cy = _mm256_blendv_ps(_mm256_blendv_ps(cy, y2, after), y1, before);
+    __m256 dx = _mm256_sub_ps(cx, px);
+    __m256 dy = _mm256_sub_ps(cy, py);
+    _mm256_storeu_ps(near_x + i, cx);
+    _mm256_storeu_ps(near_y + i, cy);
+    _mm256_storeu_ps(dist_sqr + i, _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+  }
+#endif
+#if !defined(SYMATH_SCALAR) && defined(__SSE2__)
+  const __m128 px4 = _mm_set1_ps(p.x);
+  const __m128 py4 = _mm_set1_ps(p.y);
+  const __m128 zero4 = _mm_setzero_ps();
+  const __m128 one4 = _mm_set1_ps(1.0f);
+  const __m128 sign4 = _mm_set1_ps(-0.0f);
+  for (; i + 4 <= n; i += 4) {
+    __m128 x1 = _mm_loadu_ps(v1_x + i);
+    __m128 y1 = _mm_loadu_ps(v1_y + i);
+    __m128 x2 = _mm_loadu_ps(v2_x + i);
+    __m128 y2 = _mm_loadu_ps(v2_y + i);
+    __m128 ax = _mm_sub_ps(x2, x1);
+    __m128 ay = _mm_sub_ps(y2, y1);
+    __m128 bx = _mm_sub_ps(x1, px4);
+    __m128 by = _mm_sub_ps(y1, py4);
+    __m128 ab = _mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by));
+    __m128 aa = _mm_add_ps(_mm_mul_ps(ax, ax), _mm_mul_ps(ay, ay));
+    __m128 t = _mm_div_ps(_mm_xor_ps(ab, sign4), aa);
+    __m128 u = _mm_sub_ps(one4, t);
+    __m128 cx = _mm_add_ps(_mm_mul_ps(u, x1), _mm_mul_ps(t, x2));
+    __m128 cy = _mm_add_ps(_mm_mul_ps(u, y1), _mm_mul_ps(t, y2));
+    //SSE2 has no blend, select through masks
+    __m128 before = _mm_cmplt_ps(t, zero4);
+    __m128 after = _mm_cmpgt_ps(t, one4);
+    cx = _mm_or_ps(_mm_and_ps(after, x2), _mm_andnot_ps(after, cx));
+    cy = _mm_or_ps(_mm_and_ps(after, y2), _mm_andnot_ps(after, cy));
+    cx = _mm_or_ps(_mm_and_ps(before, x1), _mm_andnot_ps(before, cx));
+    cy = _mm_or_ps(_mm_and_ps(before, y1), _mm_andnot_ps(before, cy));
+    __m128 dx = _mm_sub_ps(cx, px4);
+    __m128 dy = _mm_sub_ps(cy, py4);
+    _mm_storeu_ps(near_x + i, cx);
+    _mm_storeu_ps(near_y + i, cy);
+    _mm_storeu_ps(dist_sqr + i, _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+  }
+#elif !defined(SYMATH_SCALAR) && defined(__wasm_simd128__)
+  const v128_t px4 = wasm_f32x4_splat(p.x);
+  const v128_t py4 = wasm_f32x4_splat(p.y);
+  const v128_t zero4 = wasm_f32x4_splat(0.0f);
+  const v128_t one4 = wasm_f32x4_splat(1.0f);
+  for (; i + 4 <= n; i += 4) {
+    v128_t x1 = wasm_v128_load(v1_x + i);
+    v128_t y1 = wasm_v128_load(v1_y + i);
+    v128_t x2 = wasm_v128_load(v2_x + i);
+    v128_t y2 = wasm_v128_load(v2_y + i);
+    v128_t ax = wasm_f32x4_sub(x2, x1);
+    v128_t ay = wasm_f32x4_sub(y2, y1);
+    v128_t bx = wasm_f32x4_sub(x1, px4);
+    v128_t by = wasm_f32x4_sub(y1, py4);
+    v128_t ab = wasm_f32x4_add(wasm_f32x4_mul(ax, bx), wasm_f32x4_mul(ay, by));
+    v128_t aa = wasm_f32x4_add(wasm_f32x4_mul(ax, ax), wasm_f32x4_mul(ay, ay));
+    v128_t t = wasm_f32x4_div(wasm_f32x4_neg(ab), aa);
+    v128_t u = wasm_f32x4_sub(one4, t);
+    v128_t cx = wasm_f32x4_add(wasm_f32x4_mul(u, x1), wasm_f32x4_mul(t, x2));
+    v128_t cy = wasm_f32x4_add(wasm_f32x4_mul(u, y1), wasm_f32x4_mul(t, y2));
+    v128_t before = wasm_f32x4_lt(t, zero4);
+    v128_t after = wasm_f32x4_gt(t, one4);
+    cx = wasm_v128_bitselect(x1, wasm_v128_bitselect(x2, cx, after), before);
+    cy = wasm_v128_bitselect(y1, wasm_v128_bitselect(y2, cy, after), before);
+    v128_t dx = wasm_f32x4_sub(cx, px4);
+    v128_t dy = wasm_f32x4_sub(cy, py4);
+    wasm_v128_store(near_x + i, cx);
+    wasm_v128_store(near_y + i, cy);
+    wasm_v128_store(dist_sqr + i, wasm_f32x4_add(wasm_f32x4_mul(dx, dx), wasm_f32x4_mul(dy, dy)));
+  }
+#endif
+  for (; i < n; i++) {
+    Vector2 near = closest_point_on_line((Vector2){v1_x[i], v1_y[i]}, (Vector2){v2_x[i], v2_y[i]}, p);
+    near_x[i] = near.x;
+    near_y[i] = near.y;
+    dist_sqr[i] = Vector2LengthSqr(Vector2Subtract(near, p));
+  }
+}
+
 Vector2 unclipping_vector(Vector2 p, float r, Vector2 near, Vector2 push_dir) {
   float dist = Vector2Distance(p, near) - r;
   if (dist >= 0)
@@ -49,4 +169,165 @@ Vector2 unclipping_vector(Vector2 p, float r, Vector2 near, Vector2 push_dir) {
   return Vector2Scale(push_dir, dot * dist);
 }
 
+void unclipping_vectors(Vector2 p, float r, const float *near_x, const float *near_y, const float *dist_sqr, const float *dir_x, const float *dir_y, float *push_x, float *push_y, int n) {
+  //the distance unclipping_vector finds is sqrtf(dist_sqr), the same sum of the same squares,
+  //and it doubles as the length Vector2Normalize divides by
+  int i = 0;
+#if !defined(SYMATH_SCALAR) && defined(__AVX2__)
+  const __m256 px = _mm256_set1_ps(p.x);
+  const __m256 py = _mm256_set1_ps(p.y);
+  const __m256 r8 = _mm256_set1_ps(r);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  for (; i + 8 <= n; i += 8) {
+    __m256 length = _mm256_sqrt_ps(_mm256_loadu_ps(dist_sqr + i));
+    __m256 dist = _mm256_sub_ps(length, r8);
+    __m256 vx = _mm256_sub_ps(_mm256_loadu_ps(near_x + i), px);
+    __m256 vy = _mm256_sub_ps(_mm256_loadu_ps(near_y + i), py);
+    __m256 il = _mm256_div_ps(one, length);
+    __m256 normalized = _mm256_cmp_ps(length, zero, _CMP_GT_OQ); //a zero vector stays as it is
+    __m256 ux = _mm256_blendv_ps(vx, _mm256_mul_ps(vx, il), normalized);
+    __m256 uy = _mm256_blendv_ps(vy, _mm256_mul_ps(vy, il), normalized);
+    __m256 dx = _mm256_loadu_ps(dir_x + i);
+    __m256 dy = _mm256_loadu_ps(dir_y + i);
+    __m256 dot = _mm256_add_ps(_mm256_mul_ps(dx, ux), _mm256_mul_ps(dy, uy));
+    __m256 s = _mm256_mul_ps(dot, dist);
+    __m256 drop = _mm256_or_ps(_mm256_cmp_ps(dist, zero, _CMP_GE_OQ), _mm256_cmp_ps(dot, zero, _CMP_GT_OQ)); //the scalar early outs, NaNs fall through like there
+    _mm256_storeu_ps(push_x + i, _mm256_andnot_ps(drop, _mm256_mul_ps(dx, s)));
+    _mm256_storeu_ps(push_y + i, _mm256_andnot_ps(drop, _mm256_mul_ps(dy, s)));
+  }
+#endif
+#if !defined(SYMATH_SCALAR) && defined(__SSE2__)
+  const __m128 px4 = _mm_set1_ps(p.x);
+  const __m128 py4 = _mm_set1_ps(p.y);
+  const __m128 r4 = _mm_set1_ps(r);
+  const __m128 zero4 = _mm_setzero_ps();
+  const __m128 one4 = _mm_set1_ps(1.0f);
+  for (; i + 4 <= n; i += 4) {
+    __m128 length = _mm_sqrt_ps(_mm_loadu_ps(dist_sqr + i));
+    __m128 dist = _mm_sub_ps(length, r4);
+    __m128 vx = _mm_sub_ps(_mm_loadu_ps(near_x + i), px4);
+    __m128 vy = _mm_sub_ps(_mm_loadu_ps(near_y + i), py4);
+    __m128 il = _mm_div_ps(one4, length);
+    __m128 normalized = _mm_cmpgt_ps(length, zero4);
+    __m128 ux = _mm_or_ps(_mm_and_ps(normalized, _mm_mul_ps(vx, il)), _mm_andnot_ps(normalized, vx));
+    __m128 uy = _mm_or_ps(_mm_and_ps(normalized, _mm_mul_ps(vy, il)), _mm_andnot_ps(normalized, vy));
+    __m128 dx = _mm_loadu_ps(dir_x + i);
+    __m128 dy = _mm_loadu_ps(dir_y + i);
+    __m128 dot = _mm_add_ps(_mm_mul_ps(dx, ux), _mm_mul_ps(dy, uy));
+    __m128 s = _mm_mul_ps(dot, dist);
+    __m128 drop = _mm_or_ps(_mm_cmpge_ps(dist, zero4), _mm_cmpgt_ps(dot, zero4));
+    _mm_storeu_ps(push_x + i, _mm_andnot_ps(drop, _mm_mul_ps(dx, s)));
+    _mm_storeu_ps(push_y + i, _mm_andnot_ps(drop, _mm_mul_ps(dy, s)));
+  }
+#elif !defined(SYMATH_SCALAR) && defined(__wasm_simd128__)
+  const v128_t px4 = wasm_f32x4_splat(p.x);
+  const v128_t py4 = wasm_f32x4_splat(p.y);
+  const v128_t r4 = wasm_f32x4_splat(r);
+  const v128_t zero4 = wasm_f32x4_splat(0.0f);
+  const v128_t one4 = wasm_f32x4_splat(1.0f);
+  for (; i + 4 <= n; i += 4) {
+    v128_t length = wasm_f32x4_sqrt(wasm_v128_load(dist_sqr + i));
+    v128_t dist = wasm_f32x4_sub(length, r4);
+    v128_t vx = wasm_f32x4_sub(wasm_v128_load(near_x + i), px4);
+    v128_t vy = wasm_f32x4_sub(wasm_v128_load(near_y + i), py4);
+    v128_t il = wasm_f32x4_div(one4, length);
+    v128_t normalized = wasm_f32x4_gt(length, zero4);
+    v128_t ux = wasm_v128_bitselect(wasm_f32x4_mul(vx, il), vx, normalized);
+    v128_t uy = wasm_v128_bitselect(wasm_f32x4_mul(vy, il), vy, normalized);
+    v128_t dx = wasm_v128_load(dir_x + i);
+    v128_t dy = wasm_v128_load(dir_y + i);
+    v128_t dot = wasm_f32x4_add(wasm_f32x4_mul(dx, ux), wasm_f32x4_mul(dy, uy));
+    v128_t s = wasm_f32x4_mul(dot, dist);
+    v128_t drop = wasm_v128_or(wasm_f32x4_ge(dist, zero4), wasm_f32x4_gt(dot, zero4));
+    wasm_v128_store(push_x + i, wasm_v128_andnot(wasm_f32x4_mul(dx, s), drop));
+    wasm_v128_store(push_y + i, wasm_v128_andnot(wasm_f32x4_mul(dy, s), drop));
+  }
+#endif
+  for (; i < n; i++) {
+    Vector2 push = unclipping_vector(p, r, (Vector2){near_x[i], near_y[i]}, (Vector2){dir_x[i], dir_y[i]});
+    push_x[i] = push.x;
+    push_y[i] = push.y;
+  }
+}
+
+float sweep_circle_rect(Vector2 p, Vector2 d, float r, Vector2 min, Vector2 max, Vector2 *normal) {
+  Vector2 near = {fminf(fmaxf(p.x, min.x), max.x), fminf(fmaxf(p.y, min.y), max.y)};
+  Vector2 away = Vector2Subtract(p, near);
+  float away_sqr = Vector2LengthSqr(away);
+  if (away_sqr < r * r) { //already touching, only block moving further in
+    if (away_sqr == 0.0f)
+      return 2.0f;
+    *normal = Vector2Scale(away, 1.0f / sqrtf(away_sqr));
+    return Vector2DotProduct(d, *normal) < 0.0f ? 0.0f : 2.0f;
+  }
+  float t_enter = -INFINITY;
+  float t_exit = 1.0f;
+  Vector2 n = Vector2Zero();
+  float p_axis[2] = {p.x, p.y};
+  float d_axis[2] = {d.x, d.y};
+  float min_axis[2] = {min.x - r, min.y - r};
+  float max_axis[2] = {max.x + r, max.y + r};
+  for (int i = 0; i < 2; i++) {
+    if (d_axis[i] == 0.0f) {
+      if (p_axis[i] < min_axis[i] || p_axis[i] > max_axis[i])
+        return 2.0f;
+      continue;
+    }
+    float t1 = (min_axis[i] - p_axis[i]) / d_axis[i];
+    float t2 = (max_axis[i] - p_axis[i]) / d_axis[i];
+    float side = -1.0f;
+    if (t1 > t2) {
+      float t = t1;
+      t1 = t2;
+      t2 = t;
+      side = 1.0f;
+    }
+    if (t1 > t_enter) {
+      t_enter = t1;
+      n = i == 0 ? (Vector2){side, 0.0f} : (Vector2){0.0f, side};
+    }
+    t_exit = fminf(t_exit, t2);
+    if (t_enter >= t_exit || t_exit <= 0.0f)
+      return 2.0f;
+  }
+  t_enter = fmaxf(t_enter, 0.0f);
+  Vector2 q = Vector2Add(p, Vector2Scale(d, t_enter));
+  bool out_x = q.x < min.x || q.x > max.x;
+  bool out_y = q.y < min.y || q.y > max.y;
+  if (out_x && out_y) { //rounded corner of the inflated rectangle
+    Vector2 corner = {q.x < min.x ? min.x : max.x, q.y < min.y ? min.y : max.y};
+    Vector2 pc = Vector2Subtract(p, corner);
+    float a = Vector2DotProduct(d, d);
+    float b = Vector2DotProduct(pc, d);
+    float c = Vector2DotProduct(pc, pc) - r * r;
+    float disc = b * b - a * c;
+    if (disc < 0.0f)
+      return 2.0f;
+    t_enter = (-b - sqrtf(disc)) / a;
+    if (t_enter < 0.0f || t_enter > 1.0f)
+      return 2.0f;
+    n = Vector2Scale(Vector2Add(pc, Vector2Scale(d, t_enter)), 1.0f / r);
+  }
+  *normal = n;
+  return t_enter;
+}
+
+bool box_overlaps_obb(Vector3 min, Vector3 max, Vector3 center, const Vector3 *axes, Vector3 half) {
+  Vector3 e = Vector3Scale(Vector3Subtract(max, min), 0.5f);
+  Vector3 d = Vector3Subtract(Vector3Add(min, e), center);
+  const float h[] = {half.x, half.y, half.z};
+  //separating axes from both boxes' faces, edge cross products are skipped
+  for (int i = 0; i < 3; i++) {
+    Vector3 a = axes[i];
+    float r = e.x * fabsf(a.x) + e.y * fabsf(a.y) + e.z * fabsf(a.z);
+    if (fabsf(Vector3DotProduct(d, a)) > h[i] + r)
+      return false;
+  }
+  Vector3 r = {0};
+  for (int i = 0; i < 3; i++)
+    r = Vector3Add(r, (Vector3){h[i] * fabsf(axes[i].x), h[i] * fabsf(axes[i].y), h[i] * fabsf(axes[i].z)});
+  return fabsf(d.x) <= e.x + r.x && fabsf(d.y) <= e.y + r.y && fabsf(d.z) <= e.z + r.z;
+}
+
 #endif
\ No newline at end of file